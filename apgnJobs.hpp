@@ -0,0 +1,103 @@
+#ifndef APGN_JOBS_HPP
+#define APGN_JOBS_HPP
+
+#include <iostream>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+namespace apgnJobs
+{
+    /// the number of cores available to share between the jobs and their engines
+    unsigned int coreBudget()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores ? cores : 1;
+    }
+
+    /// splits the core budget evenly between the concurrent jobs, every engine gets at least one thread
+    int engineThreads(size_t jobs)
+    {
+        size_t threads = coreBudget() / (jobs ? jobs : 1);
+        return threads ? (int) threads : 1;
+    }
+
+    /// runs task(0) ... task(count-1) with up to `jobs` of them at once, and returns how many failed.
+    /// each task runs in its own child process since pgn-extract, which converts the games on
+    /// either side of the analysis, keeps its state in globals, and a file's games are streamed
+    /// through it for as long as they are analysed, tasks only share the files they write so the
+    /// results are the same as running them in order.
+    size_t runConcurrently(size_t count, size_t jobs, const std::function<void(size_t)>& task)
+    {
+        size_t failed = 0;
+
+        #if defined(__linux__)
+        if(jobs > 1)
+        {
+            std::map<pid_t, size_t> running;
+            size_t next = 0;
+
+            while(next < count || !running.empty())
+            {
+                while(next < count && running.size() < jobs)
+                {
+                    // anything still buffered would otherwise be written by the child as well
+                    std::cout.flush();
+                    std::cerr.flush();
+
+                    pid_t pid = fork();
+                    if(pid == -1) throw std::runtime_error("error forking a job process in runConcurrently()");
+
+                    if(pid == 0)
+                    {
+                        int status = 0;
+                        try {
+                            task(next);
+                        }
+                        catch(const std::exception& err) {
+                            std::cerr << err.what() << "\n";
+                            status = 1;
+                        }
+                        std::cout.flush();
+                        std::cerr.flush();
+                        _exit(status);
+                    }
+
+                    running[pid] = next++;
+                }
+
+                int status;
+                pid_t pid = waitpid(-1, &status, 0);
+                if(pid == -1) throw std::runtime_error("error waiting for a job process in runConcurrently()");
+
+                if(running.erase(pid) && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+                    failed++;
+            }
+
+            return failed;
+        }
+        #endif
+
+        for(size_t i=0; i<count; ++i)
+        {
+            try {
+                task(i);
+            }
+            catch(const std::exception& err) {
+                std::cerr << err.what() << "\n";
+                failed++;
+            }
+        }
+
+        return failed;
+    }
+}
+
+#endif
@@ -2,24 +2,25 @@
 #define APGN_CONVERT_HPP
 
 #include <iostream>
-#include <vector>
+#include <sstream>
 #include <string>
-#include <filesystem>
+#include <cstdio>
+#include <stdexcept>
 #include <stdlib.h>
-#include <sys/types.h>
-
-#include <string.h>
-#include <fstream>
-
-#include "apgnFileSys.hpp"
+#include <streambuf>
+#include <thread>
+#include <vector>
 
-#if defined(__linux__)
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
-#include <wait.h>
-#else
-#include "winProcRun.hpp"
+#include <sys/wait.h>
 #endif
 
+#include "dependencies/pgn-extract/pgnextract.h"
+#include "dependencies/uci-analyser/analyse.h"
+
 namespace apgn_convert
 {
     namespace COLOR
@@ -28,226 +29,393 @@ namespace apgn_convert
         const char WHITE = 'W';
         const char BLACK = 'B';
     }
-    
-    int run_subprog(std::string program, char *const args[])
+
+    /// pgn-extract reads and writes FILE streams, these keep them in memory where the platform allows it
+    std::FILE *open_read_buffer(const std::string& text)
     {
-        #if defined(__linux__)
-        int status;
+        #if defined(_WIN32)
+        std::FILE *stream = std::tmpfile();
+        if(stream)
+        {
+            std::fwrite(text.data(), 1, text.size(), stream);
+            std::rewind(stream);
+        }
+        #else
+        // fmemopen rejects zero sized buffers, an empty file reads the same
+        std::FILE *stream = text.empty() ? std::tmpfile() : fmemopen((void*)text.data(), text.size(), "r");
+        #endif
+        if(!stream) throw std::runtime_error("unable to create an input stream for pgn-extract");
+        return stream;
+    }
 
-        if(!std::filesystem::exists(program))
-            throw std::logic_error("'"+std::string(program)+"' file not found");
+    /// pgn-extract's tables are set up once per process
+    void init_pgn_extract()
+    {
+        static bool initialised = false;
+        if(!initialised)
+        {
+            pgn_extract_init();
+            initialised = true;
+        }
+    }
 
-        int pid = fork();
+    /// runs the pgn-extract library over the games in input, returning its output in the -W format given
+    std::string run_pgn_extract(std::FILE *input, const std::string& input_name, const std::string& format, unsigned flags = 0)
+    {
+        init_pgn_extract();
 
-        if(pid==-1) throw std::runtime_error("error forking subprocess");
+        std::string result;
 
-        if(pid==0) execv(program.data(),args);
-        else       waitpid(pid, &status, 0);
+        #if defined(_WIN32)
+        std::FILE *output = std::tmpfile();
+        if(!output) throw std::runtime_error("unable to create an output stream for pgn-extract");
 
-        return status;
-        #elif defined(_WIN32)
-        std::vector<std::string> cmdArguments;
+        pgn_extract_convert(input, input_name.c_str(), output, format.c_str(), flags);
 
-        size_t ARGI = 0;
-        while(args[ARGI]!=NULL)
+        char buffer[4096];
+        size_t nbytes;
+        std::rewind(output);
+        while((nbytes = std::fread(buffer, 1, sizeof(buffer), output)) > 0)
         {
-            cmdArguments.push_back(args[ARGI]);
-            ARGI++;
+            result.append(buffer, nbytes);
         }
-        apgn::runAndGrabOutput(program.c_str(),cmdArguments);
-        return 0;
+        std::fclose(output);
+        #else
+        char *buffer = NULL;
+        size_t size = 0;
+        std::FILE *output = open_memstream(&buffer, &size);
+        if(!output) throw std::runtime_error("unable to create an output stream for pgn-extract");
+
+        pgn_extract_convert(input, input_name.c_str(), output, format.c_str(), flags);
+
+        std::fclose(output);
+        result.assign(buffer, size);
+        free(buffer);
         #endif
+
+        return result;
     }
 
-    void uci_to_pgn(const std::string& input, const std::string output)
+    /// set once the ECO lines are read, pgn-extract then gives each game a BookDepth tag
+    bool eco_book_depth = false;
+
+    /// reads the opening lines of the ECO file, so that the analysis of each game starts where
+    /// it leaves them rather than after a fixed number of moves
+    void use_eco_book_depth(const std::string& eco_file)
     {
-        std::string PGN_EXTRACT = "pgn-extract", FLG1 = "-WsanPNBRQK", FLG2 = "--output";
-        char *const args[] = {PGN_EXTRACT.data(),FLG1.data(),FLG2.data(),(char* const)output.c_str(),(char* const)input.c_str(),NULL};
+        init_pgn_extract();
+        if(!pgn_extract_load_eco(eco_file.c_str()))
+            throw std::runtime_error("unable to read the ECO file '"+eco_file+"'");
+        eco_book_depth = true;
+    }
 
-        #if defined(__linux__)
-        run_subprog((std::filesystem::path(apgnFileSys::getExecpath()) / "bin" / "pgn-extract").string(),args);
-        #elif defined(_WIN32)
-        run_subprog((std::filesystem::path(apgnFileSys::getExecpath()) / "bin" / "pgn-extract" / "pgn-extract.exe").string(),args);
-        #endif
+    /// set once a polyglot book is open, pgn-extract then marks the moves found in it
+    bool polyglot_book = false;
+
+    /// opens the polyglot (.bin) opening book, the plies whose played move is one of its
+    /// moves for the position are not analysed
+    void use_polyglot_book(const std::string& book_file)
+    {
+        init_pgn_extract();
+        if(!pgn_extract_load_book(book_file.c_str()))
+            throw std::runtime_error("unable to read the polyglot book '"+book_file+"'");
+        polyglot_book = true;
+    }
+
+    /// pgn-extract adds the FEN of each position as a comment, so the engine is given each
+    /// position without the whole game before it, and marks the positions with only one
+    /// legal move, which are not searched; the evaluation cache needs the hash code of each
+    /// position, which it adds as comments too
+    unsigned uci_flags(const AnalysisOptions& options)
+    {
+        return PGN_EXTRACT_FEN_COMMENTS | PGN_EXTRACT_FORCED_COMMENTS |
+               (options.cacheFile.empty() ? 0 : PGN_EXTRACT_HASH_COMMENTS) |
+               (eco_book_depth ? PGN_EXTRACT_BOOK_DEPTH : 0) |
+               (polyglot_book ? PGN_EXTRACT_BOOK_COMMENTS : 0);
     }
 
-    void pgn_to_uci(const std::string& input, const std::string output)
+    /// the BookDepth tags that pgn-extract added for the analysis are left out of the
+    /// annotated pgn
+    unsigned san_flags()
     {
-        std::string PGN_EXTRACT = "pgn-extract", FLG1 = "-Wuci", FLG2 = "--output";
-        char *const args[] = {PGN_EXTRACT.data(),FLG1.data(),FLG2.data(),(char* const)output.c_str(),(char* const)input.c_str(),NULL};
+        return eco_book_depth ? PGN_EXTRACT_NO_BOOK_DEPTH : 0;
+    }
 
-        #if defined(__linux__)
-        run_subprog((std::filesystem::path(apgnFileSys::getExecpath()) / "bin" / "pgn-extract").string(),args);
-        #elif defined(_WIN32)
-        run_subprog((std::filesystem::path(apgnFileSys::getExecpath()) / "bin" / "pgn-extract" / "pgn-extract.exe").string(),args);
-        #endif
+    /// returns the games of the input pgn file with their moves in uci (long algebraic) form
+    std::string pgn_to_uci(const std::string& input, unsigned flags = 0)
+    {
+        std::FILE *pgn = std::fopen(input.c_str(), "rb");
+        if(!pgn) throw std::runtime_error("unable to open '"+input+"'");
+
+        std::string uci_games = run_pgn_extract(pgn, input, "uci", flags);
+        std::fclose(pgn);
+        return uci_games;
+    }
+
+    /// writes the analysed uci games to the output file as a san pgn
+    void uci_to_pgn(const std::string& analysed_games, const std::string& output)
+    {
+        std::FILE *pgn = std::fopen(output.c_str(), "wb");
+        if(!pgn) throw std::runtime_error("unable to create '"+output+"'");
+
+        init_pgn_extract();
+        std::FILE *input = open_read_buffer(analysed_games);
+        pgn_extract_convert(input, output.c_str(), pgn, "sanPNBRQK", san_flags());
+        std::fclose(input);
+        std::fclose(pgn);
     }
 
-    void analyse_game(
-        std::string input,
-        std::string output,
-        std::string engine,
-        char* search_depth,
-        char* threads,
-        char* opening_move_skips,
-        char* moves_until,
+    /// the analyser settings for apgn's flags, the games, or their plies if split_plies is set,
+    /// are shared between `engines` instances of the engine,
+    /// the statistics are appended to stats_file + ".stats.txt"
+    AnalysisOptions analysis_options(
+        const std::string& stats_file,
+        const std::string& engine,
+        int search_depth,
+        int threads,
+        int engines,
+        bool split_plies,
+        int opening_move_skips,
+        int moves_until,
         char apgn_COLOR
-    )   
+    )
     {
-        std::string analyse_ = "analyse", engine_ = "--engine", searchd_ = "--searchdepth", bookd_ = "--bookdepth", setopt_ = "--setoption",
-                    movesuntil_ = "--movesuntil", threads_ = "Threads", annotate_ = "--annotatePGN", white_ = "--whiteonly", black_ = "--blackonly";
+        AnalysisOptions options;
+        options.engineName = engine;
+        options.searchDepth = search_depth;
+        options.bookDepth = opening_move_skips;
+        options.movesUntil = moves_until;
+        options.engineOptions["Threads"] = std::to_string(threads);
+        options.engines = engines;
+        options.splitPlies = split_plies;
+        options.annotate = true;
+        options.XMLformat = false;
+        options.statsFile = stats_file;
 
-        #if defined(__linux__)
-        char *const args[] = {
-        #else
-        std::vector<std::string> args = {
-        #endif
-            analyse_.data(),
-            engine_.data(),engine.data(),
-            searchd_.data(),search_depth,
-            bookd_.data(),opening_move_skips,
-            movesuntil_.data(),moves_until,
-            setopt_.data(),threads_.data(),threads,
-            #if defined(__linux__)
-            annotate_.data(),input.data(),
-            NULL
-            #else
-            annotate_.data(),input.data()
-            #endif
-        };
-
-        #if defined(__linux__)
-        char *const args_white[] = {
-        #else
-        std::vector<std::string> args_white = {
-        #endif
-            analyse_.data(),
-            engine_.data(),engine.data(),
-            white_.data(),
-            searchd_.data(),search_depth,
-            bookd_.data(),opening_move_skips,
-            movesuntil_.data(),moves_until,
-            setopt_.data(),threads_.data(),threads,
-            #if defined(__linux__)
-            annotate_.data(),input.data(),
-            NULL
-            #else
-            annotate_.data(),input.data()
-            #endif
-        };
-
-        #if defined(__linux__)
-        char *const args_black[] = {
-        #else
-        std::vector<std::string> args_black = {
-        #endif
-            analyse_.data(),
-            engine_.data(),engine.data(),
-            black_.data(),
-            searchd_.data(),search_depth,
-            bookd_.data(),opening_move_skips,
-            movesuntil_.data(),moves_until,
-            setopt_.data(),threads_.data(),threads,
-            #if defined(__linux__)
-            annotate_.data(),input.data(),
-            NULL
-            #else
-            annotate_.data(),input.data()
-            #endif
-        };
-
-        #if defined(__linux__)
-        std::string result_pgn = "";
-        char std_output[4096+1];
-        memset(std_output,0,4096);
-
-        int reader[2];
-        if(pipe(reader)==-1) std::runtime_error("error creating pipe for stdout reading in analyse_game()");
-
-        int pid = fork();
-
-        if(pid==-1) std::runtime_error("error forking parent process, unable to create a child process in analyse_game()");
-
-        std::string analyse_executable_path = apgnFileSys::getExecpath()+"/bin/analyse";
-
-        if(pid==0)
+        switch (apgn_COLOR)
         {
-            dup2(reader[1], STDOUT_FILENO);
-            close(reader[0]);
-            switch (apgn_COLOR)
-            {
             case COLOR::ALL:
-                execv(analyse_executable_path.data(),args);
                 break;
             case COLOR::WHITE:
-                execv(analyse_executable_path.data(),args_white);
+                options.analyseBlack = false;
                 break;
             case COLOR::BLACK:
-                execv(analyse_executable_path.data(),args_black);
+                options.analyseWhite = false;
                 break;
             default:
                 throw std::runtime_error("something happend - error in convert.hpp");
                 break;
-            }
-            close(reader[1]);
         }
-        else
-        {
-            close(reader[1]);
-            int nbytes = 0;
-            while(read(reader[0], std_output, sizeof(std_output)) != 0)
+
+        return options;
+    }
+
+    /// analyses the uci games with the engine, returning them annotated
+    std::string analyse_game(const std::string& uci_games, const AnalysisOptions& options)
+    {
+        std::istringstream games(uci_games);
+        std::ostringstream analysed_games;
+
+        if(!analyseStream(games, analysed_games, options))
+            throw std::runtime_error("unable to analyse the games with '"+options.engineName+"'");
+
+        return analysed_games.str();
+    }
+
+    #if !defined(_WIN32)
+    /// a streambuf over a file descriptor, a read returns whatever has arrived so a pipe
+    /// is consumed game by game as it fills, writes are held until the stream is flushed,
+    /// which the analyser does at the end of each game, or until the buffer is full
+    class fd_streambuf : public std::streambuf
+    {
+        public:
+            explicit fd_streambuf(int descriptor) : fd(descriptor) {}
+            ~fd_streambuf() override { sync(); }
+
+        protected:
+            int_type underflow() override
+            {
+                ssize_t count;
+                do {
+                    count = ::read(fd, input, sizeof(input));
+                } while(count<0 && errno==EINTR);
+
+                if(count<=0) return traits_type::eof();
+                setg(input, input, input+count);
+                return traits_type::to_int_type(*gptr());
+            }
+
+            int_type overflow(int_type ch) override
+            {
+                if(!write_output()) return traits_type::eof();
+                if(!traits_type::eq_int_type(ch, traits_type::eof()))
+                {
+                    *pptr() = traits_type::to_char_type(ch);
+                    pbump(1);
+                }
+                return traits_type::not_eof(ch);
+            }
+
+            int sync() override
+            {
+                return write_output() ? 0 : -1;
+            }
+
+        private:
+            /// writes out what the buffer holds, the buffer is only allocated on the first
+            /// write so a streambuf that is only read from does not carry one
+            bool write_output()
             {
-                result_pgn+=std_output;
-                memset(std_output,0,4096);
+                const char *s = pbase();
+                std::streamsize count = pptr()-pbase();
+                std::streamsize written = 0;
+                while(written<count)
+                {
+                    ssize_t n = ::write(fd, s+written, count-written);
+                    if(n<0)
+                    {
+                        if(errno==EINTR) continue;
+                        break;
+                    }
+                    written += n;
+                }
+
+                if(output.empty()) output.resize(OUTPUT_BUFFER_SIZE);
+                setp(output.data(), output.data()+output.size());
+                return written==count;
             }
-            close(reader[0]);
-            wait(NULL);
+
+            static const size_t OUTPUT_BUFFER_SIZE = 1<<16;
+            int fd;
+            char input[4096];
+            std::vector<char> output;
+    };
+
+    /// creates a pipe that is closed on exec, an engine started while it is open must not
+    /// hold on to it, or the reader would not see the end of the pipe until the engine quits
+    bool open_pipe(int fds[2])
+    {
+        if(pipe(fds)!=0) return false;
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+    }
+
+    /// analyses the uci games read from `games` and writes them to pgn as san, each game goes
+    /// through a pipe to pgn-extract as soon as it is analysed, so only the games in progress
+    /// are held in memory and the output grows game by game
+    void analyse_into_pgn(std::istream& games, const AnalysisOptions& options, std::FILE *pgn, const std::string& output_name)
+    {
+        init_pgn_extract();
+
+        int fds[2];
+        if(!open_pipe(fds)) throw std::runtime_error("unable to create a pipe to pgn-extract");
+        std::FILE *reader = fdopen(fds[0], "rb");
+        if(!reader)
+        {
+            close(fds[0]);
+            close(fds[1]);
+            throw std::runtime_error("unable to read the pipe to pgn-extract");
         }
+
+        bool analysed = false;
+        std::thread analyser([&]()
+        {
+            try {
+                fd_streambuf buffer(fds[1]);
+                std::ostream analysed_games(&buffer);
+                analysed = analyseStream(games, analysed_games, options);
+            }
+            catch(const std::exception& err) {
+                std::cerr << err.what() << "\n";
+            }
+            // pgn-extract stops at the end of the pipe
+            close(fds[1]);
+        });
+
+        pgn_extract_convert(reader, output_name.c_str(), pgn, "sanPNBRQK", san_flags());
+
+        analyser.join();
+        std::fclose(reader);
+
+        if(!analysed)
+            throw std::runtime_error("unable to analyse the games with '"+options.engineName+"'");
+    }
+    #endif
+
+    /// analyses the uci games with the engine and writes them to the output file as a san pgn
+    void analyse_to_pgn(const std::string& uci_games, const AnalysisOptions& options, const std::string& output)
+    {
+        #if defined(_WIN32)
+        uci_to_pgn(analyse_game(uci_games, options), output);
         #else
-        std::string analyse_executable_path = "";
-        
-        #if defined(__linux__)
-        analyse_executable_path = (std::filesystem::path(apgnFileSys::getExecpath()) / "bin" / "analyse").string();
-        #elif defined(_WIN32)
-        analyse_executable_path = (std::filesystem::path(apgnFileSys::getExecpath()) / "bin" / "analyse" / "analyse.exe").string();
+        std::FILE *pgn = std::fopen(output.c_str(), "wb");
+        if(!pgn) throw std::runtime_error("unable to create '"+output+"'");
+
+        std::istringstream games(uci_games);
+        try {
+            analyse_into_pgn(games, options, pgn, output);
+        }
+        catch(...) {
+            std::fclose(pgn);
+            throw;
+        }
+        std::fclose(pgn);
         #endif
+    }
 
-        std::string result_pgn;
+    /// analyses the pgn games read from stdin, writing them annotated to stdout game by game,
+    /// pgn-extract only does one conversion at a time so the games are converted to uci in a
+    /// child process, which lets the analysis start before all of the input has arrived
+    void analyse_stdin(const AnalysisOptions& options)
+    {
+        #if defined(_WIN32)
+        std::string uci_games = run_pgn_extract(stdin, "stdin", "uci", uci_flags(options));
+        std::FILE *input = open_read_buffer(analyse_game(uci_games, options));
+        pgn_extract_convert(input, "stdout", stdout, "sanPNBRQK", san_flags());
+        std::fclose(input);
+        #else
+        init_pgn_extract();
 
-        switch (apgn_COLOR)
+        int fds[2];
+        if(!open_pipe(fds)) throw std::runtime_error("unable to create a pipe from pgn-extract");
+
+        std::cout.flush();
+        std::fflush(stdout);
+        pid_t pid = fork();
+        if(pid == -1) throw std::runtime_error("error forking the pgn-extract process in analyse_stdin()");
+
+        if(pid == 0)
         {
-            case COLOR::ALL:
-                result_pgn = apgn::runAndGrabOutput(analyse_executable_path.data(),args);
-                break;
-            case COLOR::WHITE:
-                result_pgn = apgn::runAndGrabOutput(analyse_executable_path.data(),args_white);
-                break;
-            case COLOR::BLACK:
-                result_pgn = apgn::runAndGrabOutput(analyse_executable_path.data(),args_black);
-                break;
-            default:
-                throw std::runtime_error("something happend - error in convert.hpp");
-                break;
+            close(fds[0]);
+            std::FILE *writer = fdopen(fds[1], "wb");
+            // each game is passed on at the end of its last line
+            setvbuf(writer, NULL, _IOLBF, 0);
+            pgn_extract_convert(stdin, "stdin", writer, "uci", uci_flags(options));
+            std::fclose(writer);
+            _exit(0);
         }
-        #endif
-
-        // check if file exist
-        std::ifstream readf;
-        readf.open(output);
 
-        if(readf.fail()){
-            readf.close();
+        close(fds[1]);
+        setvbuf(stdout, NULL, _IOLBF, 0);
 
-            std::ofstream file;
-            file.open(output);
-            file.close();
+        fd_streambuf buffer(fds[0]);
+        std::istream uci_games(&buffer);
+        try {
+            analyse_into_pgn(uci_games, options, stdout, "stdout");
+        }
+        catch(...) {
+            close(fds[0]);
+            waitpid(pid, NULL, 0);
+            throw;
         }
+        close(fds[0]);
 
-        std::ofstream outfile;
-        outfile.open(output,std::ios_base::trunc);
-        outfile<<result_pgn;
-        outfile.close();
+        int status;
+        if(waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            throw std::runtime_error("unable to convert the games on stdin");
+        #endif
     }
 }
 
-#endif
\ No newline at end of file
+#endif
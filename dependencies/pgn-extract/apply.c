@@ -25,9 +25,11 @@
 #include <ctype.h>
 #include "bool.h"
 #include "mymalloc.h"
+#include "arena.h"
 #include "defs.h"
 #include "typedef.h"
 #include "map.h"
+#include "bitboard.h"
 #include "apply.h"
 #include "tokens.h"
 #include "taglist.h"
@@ -40,6 +42,7 @@
 #include "hashing.h"
 #include "fenmatcher.h"
 #include "zobrist.h"
+#include "polyglot.h"
 
 /* Define a positional search depth that should look at the
  * full length of a game.  This is used in play_moves().
@@ -696,6 +699,7 @@ new_game_board(const char *fen)
             }
         }
     }
+    set_bitboards(new_board);
     return new_board;
 }
 
@@ -875,8 +879,8 @@ apply_move(Move *move_details, Board *board)
             if (GlobalState.output_format == EPD || GlobalState.add_FEN_comments) {
                 char epd[FEN_SPACE], fen_suffix[FEN_SPACE];
                 build_FEN_components(board, epd, fen_suffix);
-                move_details->epd = copy_string(epd);
-                move_details->fen_suffix = copy_string(fen_suffix);
+                move_details->epd = game_copy_string(epd);
+                move_details->fen_suffix = game_copy_string(fen_suffix);
             }
 
         }
@@ -908,6 +912,11 @@ play_moves(Game *game_details, Board *board, Move *moves, unsigned max_depth,
     Move *next_move = moves;
     /* Keep track of the final ECO match. */
     EcoLog *eco_match = NULL;
+    /* The last ply of the game whose position is on the ECO lines,
+     * and how many plies have been played off them since.
+     */
+    unsigned eco_lines_ply = 0;
+    unsigned plies_off_eco_lines = 0;
     Boolean null_move_in_main_line = FALSE;
     /* Whether the fifty-move rule was available in the main line. */
     Boolean fifty_move_rule_applies = FALSE;
@@ -1068,11 +1077,7 @@ play_moves(Game *game_details, Board *board, Move *moves, unsigned max_depth,
                             if (corrected_result != NULL) {
                                 free((void *) result);
                                 game_details->tags[RESULT_TAG] = copy_string(corrected_result);
-                                if(next_move->terminating_result != NULL) {
-                                    free((void *) next_move->terminating_result);
-                                    next_move->terminating_result = NULL;
-                                }
-                                next_move->terminating_result = copy_string(corrected_result);
+                                next_move->terminating_result = game_copy_string(corrected_result);
                             }
                         }
 
@@ -1146,6 +1151,19 @@ play_moves(Game *game_details, Board *board, Move *moves, unsigned max_depth,
                             }
                         }
                     }
+                    /* A single move off the lines may be a different
+                     * order of moves that rejoins them, but after two
+                     * the game has left them.
+                     */
+                    if (GlobalState.add_book_depth_tag && plies_off_eco_lines < 2) {
+                        if (is_eco_position(board->weak_hash_value)) {
+                            eco_lines_ply = half_moves_played(board);
+                            plies_off_eco_lines = 0;
+                        }
+                        else {
+                            plies_off_eco_lines++;
+                        }
+                    }
                     next_move = next_move->next;
                 }
                 else {
@@ -1201,7 +1219,16 @@ play_moves(Game *game_details, Board *board, Move *moves, unsigned max_depth,
         }
     }
     if (game_ok) {
-        if (eco_match != NULL) {
+        if (GlobalState.add_book_depth_tag && mainline &&
+                game_details->tags[BOOK_DEPTH_TAG] == NULL) {
+            /* The plies up to the last position on the ECO lines
+             * are taken to be known opening play.
+             */
+            char formatted_ply[FORMATTED_NUMBER_SIZE];
+            sprintf(formatted_ply, "%u", eco_lines_ply);
+            game_details->tags[BOOK_DEPTH_TAG] = copy_string(formatted_ply);
+        }
+        if (GlobalState.add_ECO && eco_match != NULL) {
             /* Free any details of the old one. */
             if (game_details->tags[ECO_TAG] != NULL) {
                 (void) free((void *) game_details->tags[ECO_TAG]);
@@ -1308,6 +1335,7 @@ play_eco_moves(Game *game_details, Board *board, Move *moves)
             if (apply_move(next_move, board)) {
                 /* Combine this hash value to the cumulative one. */
                 game_details->cumulative_hash_value += board->weak_hash_value;
+                save_eco_position(board->weak_hash_value);
                 next_move = next_move->next;
             }
             else {
@@ -1789,6 +1817,11 @@ rewrite_moves(Game *game, Board *board, Move *moves)
                 /* Something wrong with the variations. */
                 game_ok = FALSE;
             }
+            /* The book is keyed by the position before the move. */
+            uint64_t book_key = 0;
+            if (GlobalState.add_book_comments) {
+                book_key = generate_zobrist_hash_from_board(board);
+            }
             if (rewrite_move(game, board->to_move, move_details, board)) {
                 if(move_details->class == NULL_MOVE && game != NULL) {
                     /* NULL_MOVE not allowed in the main line. */
@@ -1808,6 +1841,14 @@ rewrite_moves(Game *game, Board *board, Move *moves)
                      */
                     move_details->zobrist = generate_zobrist_hash_from_board(board);
                 }
+
+                if (GlobalState.add_forced_comments) {
+                    move_details->forced = only_one_move(board, board->to_move);
+                }
+
+                if (GlobalState.add_book_comments) {
+                    move_details->book = polyglot_book_move(book_key, move_details);
+                }
                 
                 if(GlobalState.drop_comment_pattern != NULL &&
                         move_details->comment_list != NULL) {
@@ -1828,8 +1869,10 @@ rewrite_moves(Game *game, Board *board, Move *moves)
                                               move_details->comment_list);
                     if(comment_to_replace != NULL) {
                         /* Replace it. */
-                        (void) free((void *) comment_to_replace->str);
-                        comment_to_replace->str = get_FEN_string(board);
+                        char *fen = get_FEN_string(board);
+
+                        comment_to_replace->str = game_copy_string(fen);
+                        (void) free((void *) fen);
                     }
                 }
 
@@ -1863,7 +1906,7 @@ rewrite_moves(Game *game, Board *board, Move *moves)
     if (!game_ok) {
         if(GlobalState.keep_broken_games && move_details != NULL) {
             /* Try to place the remaining moves into a comment. */
-            CommentList *comment = (CommentList*) malloc_or_die(sizeof (*comment));
+            CommentList *comment = (CommentList*) game_malloc(sizeof (*comment));
             /* Break the link from the previous move. */
             Move *prev;
             StringList *commented_move_list = NULL;
@@ -2040,17 +2083,7 @@ drop_plies_from_start(Game *game, Move *moves, int plies_to_drop)
         if(game->tags[TOTAL_PLY_COUNT_TAG] != NULL || GlobalState.output_total_plycount) {
             add_total_plycount(game, GlobalState.keep_variations);
         }
-
-        /* Make sure we aren't dropping 0 moves. */
-        if(new_head != moves) {
-            /* Free the dropped moves. */
-            Move *move_to_drop = moves;
-            while(move_to_drop->next != new_head) {
-                move_to_drop = move_to_drop->next;
-            }
-            move_to_drop->next = NULL;
-            free_move_list(moves);
-        }
+        /* The dropped moves are freed along with the rest of the game. */
     }
     else {
         game_ok = FALSE;
@@ -2615,13 +2648,16 @@ create_match_comment(const Board *board)
     char *match_comment;
     
     if(strcmp(GlobalState.position_match_comment, "FEN") != 0) {
-        match_comment = copy_string(GlobalState.position_match_comment);
+        match_comment = game_copy_string(GlobalState.position_match_comment);
     }
     else {
-        match_comment = get_FEN_string(board);
+        char *fen = get_FEN_string(board);
+
+        match_comment = game_copy_string(fen);
+        (void) free((void *) fen);
     }
     StringList *current_comment = save_string_list_item(NULL, match_comment);
-    CommentList *comment = (CommentList*) malloc_or_die(sizeof (*comment));
+    CommentList *comment = (CommentList*) game_malloc(sizeof (*comment));
 
     comment->comment = current_comment;
     comment->next = NULL;
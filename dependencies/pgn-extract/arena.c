@@ -0,0 +1,130 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/*
+ * Everything that hangs off the move list of a game - the moves,
+ * their variations, NAGs and comments, and the strings of these - is
+ * taken from a succession of blocks rather than being allocated one
+ * item at a time, and is never freed on its own. Once the game has been
+ * dealt with, free_game_space() makes all of it available again for
+ * the next game. The tags are not stored here, as they are replaced
+ * and freed individually.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mymalloc.h"
+#include "arena.h"
+
+/* The usual size of a block. */
+#define BLOCK_SIZE (1 << 16)
+/* Every allocation is aligned to this, as is the start of a block's space. */
+#define ALIGNMENT 16
+#define ALIGN(n) (((n) + ALIGNMENT - 1) & ~((size_t) ALIGNMENT - 1))
+
+typedef struct Block {
+    /* The block filled before this one. */
+    struct Block *previous;
+    /* The size of the space that follows the header, and how much is used. */
+    size_t size;
+    size_t used;
+} Block;
+
+#define HEADER_SIZE ALIGN(sizeof(Block))
+
+/* The block being filled, the most recent. */
+static Block *current_block = NULL;
+
+static Block *
+new_block(size_t size, Block *previous)
+{
+    Block *block = (Block *) malloc_or_die(HEADER_SIZE + size);
+
+    block->previous = previous;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/* Return nbytes of space that lasts until free_game_space() is called. */
+void *
+game_malloc(size_t nbytes)
+{
+    void *space;
+
+    nbytes = ALIGN(nbytes);
+    if (current_block == NULL || current_block->size - current_block->used < nbytes) {
+        size_t size = BLOCK_SIZE;
+
+        if (current_block != NULL && current_block->size > size) {
+            size = current_block->size;
+        }
+        while (size < nbytes) {
+            size *= 2;
+        }
+        current_block = new_block(size, current_block);
+    }
+    space = (char *) current_block + HEADER_SIZE + current_block->used;
+    current_block->used += nbytes;
+    return space;
+}
+
+/* Return a copy of str that lasts until free_game_space() is called. */
+char *
+game_copy_string(const char *str)
+{
+    char *result = NULL;
+
+    if (str != NULL) {
+        size_t len = strlen(str);
+
+        result = (char *) game_malloc(len + 1);
+        memcpy(result, str, len + 1);
+    }
+    return result;
+}
+
+/* Release everything allocated since the last call.
+ * If that took more than one block, they are replaced by a single
+ * block large enough for all of it, so a game like it needs only one.
+ */
+void
+free_game_space(void)
+{
+    if (current_block != NULL) {
+        if (current_block->previous != NULL) {
+            size_t total = 0;
+
+            while (current_block != NULL) {
+                Block *previous = current_block->previous;
+
+                total += current_block->size;
+                (void) free((void *) current_block);
+                current_block = previous;
+            }
+            current_block = new_block(total, NULL);
+        }
+        else {
+            current_block->used = 0;
+        }
+    }
+}
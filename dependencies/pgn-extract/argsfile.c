@@ -40,6 +40,7 @@
 #include "lists.h"
 #include "mymalloc.h"
 #include "fenmatcher.h"
+#include "polyglot.h"
 
 #define CURRENT_VERSION "v21-02"
 #define URL "https://www.cs.kent.ac.uk/people/staff/djb/pgn-extract/"
@@ -188,6 +189,7 @@ usage_and_exit(void)
 
         "",
 
+        "--addbookdepth - output a BookDepth tag of the plies that follow the ECO lines (see -e)",
         "--addhashcode - output a HashCode tag",
         "--addlabeltag - output a MatchLabel tag with FENPattern",
         "--addmatchtag - output a MaterialMatch tag with -z",
@@ -207,9 +209,11 @@ usage_and_exit(void)
         "--fifty - only output games that include fifty moves with no capture or pawn move.",
         "--fixresulttags - correct Result tags that conflict with the game outcome or terminating result.",
         "--fixtagstrings - attempt to correct tag strings that are not properly terminated.",
+        "--forcedcomments - include a 'forced' comment after each move that leaves only one legal reply",
         "--fuzzydepth plies - positional duplicates match",
         "--hashcomments - include a hashcode string after each move",
         "--help - see -h",
+        "--jobs N - share the parsing of each file between N processes",
         "--json - output the game in JSON format",
         "--keepbroken - retain games with errors",
         "--linelength - see -w",
@@ -235,6 +239,7 @@ usage_and_exit(void)
         "--output - see -o",
         "--plycount - include a PlyCount tag.",
         "--plylimit - limit the number of plies output.",
+        "--polyglotbook file - include a 'book' comment after each move of the given Polyglot book",
         "--quiescent N - position quiescence length (default 0)",
         "--quiet - No status processing output (see, also, -s).",
         "--repetition - only output games that include 3-fold repetition.",
@@ -1007,7 +1012,12 @@ process_argument(char arg_letter, const char *associated_value)
 int
 process_long_form_argument(const char *argument, const char *associated_value)
 {
-    if (stringcompare(argument, "addhashcode") == 0) {
+    if (stringcompare(argument, "addbookdepth") == 0) {
+        GlobalState.add_book_depth_tag = TRUE;
+        initEcoTable();
+        return 1;
+    }
+    else if (stringcompare(argument, "addhashcode") == 0) {
         GlobalState.add_hashcode_tag = TRUE;
         return 1;
     }
@@ -1132,6 +1142,11 @@ process_long_form_argument(const char *argument, const char *associated_value)
         GlobalState.fix_tag_strings = TRUE;
         return 1;
     }
+    else if (stringcompare(argument, "forcedcomments") == 0) {
+        /* Output a comment after each move that leaves only one reply. */
+        GlobalState.add_forced_comments = TRUE;
+        return 1;
+    }
     else if (stringcompare(argument, "fuzzydepth") == 0) {
         /* Extract the depth. */
         unsigned depth = 0;
@@ -1156,6 +1171,20 @@ process_long_form_argument(const char *argument, const char *associated_value)
         process_argument(HELP_ARGUMENT, "");
         return 1;
     }
+    else if (stringcompare(argument, "jobs") == 0) {
+        /* Extract the number of worker processes. */
+        unsigned jobs = 0;
+
+        if (sscanf(associated_value, "%u", &jobs) == 1 && jobs > 0) {
+            GlobalState.jobs = jobs;
+        }
+        else {
+            fprintf(GlobalState.logfile,
+                    "--%s requires a number greater than zero following it.\n", argument);
+            exit(1);
+        }
+        return 2;
+    }
     else if (stringcompare(argument, "json") == 0) {
         GlobalState.json_format = TRUE;
         return 1;
@@ -1347,6 +1376,21 @@ process_long_form_argument(const char *argument, const char *associated_value)
         }
         return 2;
     }
+    else if (stringcompare(argument, "polyglotbook") == 0) {
+        /* Output a comment after each move found in the book. */
+        if (*associated_value != '\0') {
+            if (!open_polyglot_book(associated_value)) {
+                exit(1);
+            }
+            GlobalState.add_book_comments = TRUE;
+        }
+        else {
+            fprintf(GlobalState.logfile,
+                    "--%s requires a file name following it.\n", argument);
+            exit(1);
+        }
+        return 2;
+    }
     else if (stringcompare(argument, "quiescent") == 0) {
         int threshold = 0;
 
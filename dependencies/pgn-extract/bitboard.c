@@ -0,0 +1,481 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/*
+ * Alongside its board[][] array, a Board holds a bitboard of the squares
+ * occupied by each kind of piece and by each colour. The attacks of the
+ * knight, king and pawns from each square are held in tables, and those
+ * of the bishop and rook are found with magic bitboards: the occupied
+ * squares on a piece's lines, multiplied by a number chosen for the
+ * square, give the index of its attacks in a table. The magic numbers
+ * were found once by a search over sparse random numbers; searching for
+ * them on each run would take far longer than filling in the tables.
+ * Whether a move leaves its own king in check is then answered from the
+ * pieces pinned against the king and those giving check, without making
+ * the move on a copy of the board.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bool.h"
+#include "defs.h"
+#include "bitboard.h"
+
+/* The number of entries in the tables of bishop and rook attacks. */
+#define BISHOP_TABLE_SIZE 0x1480
+#define ROOK_TABLE_SIZE 0x19000
+/* The squares on the edges of the board. */
+#define FIRST_RANK_SQUARES ((Bitboard) 0xFF)
+#define LAST_RANK_SQUARES (FIRST_RANK_SQUARES << (NUM_SQUARES - BOARDSIZE))
+#define FIRST_COL_SQUARES ((Bitboard) 0x0101010101010101ULL)
+#define LAST_COL_SQUARES (FIRST_COL_SQUARES << (BOARDSIZE - 1))
+
+/* The rank and column offsets of the moves of the pieces. */
+static const int Knight_steps[][2] = {
+    { 1, 2 }, { 1, -2 }, { 2, 1 }, { 2, -1 },
+    { -1, 2 }, { -1, -2 }, { -2, 1 }, { -2, -1 }
+};
+static const int King_steps[][2] = {
+    { 1, 0 }, { 1, 1 }, { 1, -1 }, { 0, 1 },
+    { 0, -1 }, { -1, 0 }, { -1, 1 }, { -1, -1 }
+};
+static const int Bishop_directions[][2] = {
+    { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 }
+};
+static const int Rook_directions[][2] = {
+    { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 }
+};
+
+/* The squares attacked from each square by the pieces whose moves
+ * are not blocked by other pieces. Pawn attacks are indexed by colour.
+ */
+static Bitboard Knight_attacks[NUM_SQUARES];
+static Bitboard King_attacks[NUM_SQUARES];
+static Bitboard Pawn_attacks[2][NUM_SQUARES];
+/* The squares strictly between two squares on a rank, column or diagonal,
+ * and the whole of the line through them. Both are empty for two squares
+ * not in line.
+ */
+static Bitboard Between[NUM_SQUARES][NUM_SQUARES];
+static Bitboard Line[NUM_SQUARES][NUM_SQUARES];
+
+/* How to find the attacks of a bishop or rook on one square. */
+typedef struct {
+    /* The squares whose occupancy matters, which exclude the edges. */
+    Bitboard mask;
+    Bitboard magic;
+    unsigned shift;
+    /* The attacks for each index. */
+    Bitboard *attacks;
+} Magic;
+
+static Magic Bishop_magics[NUM_SQUARES];
+static Magic Rook_magics[NUM_SQUARES];
+static Bitboard Bishop_table[BISHOP_TABLE_SIZE];
+static Bitboard Rook_table[ROOK_TABLE_SIZE];
+
+/* The magic numbers of the bishop and rook on each square. */
+static const Bitboard Bishop_magic_numbers[NUM_SQUARES] = {
+    0x40106000a1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL,
+    0x002806004050c040ULL, 0x0002021018000000ULL, 0x2001112010000400ULL,
+    0x0881010120218080ULL, 0x1030820110010500ULL, 0x0000120222042400ULL,
+    0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422a02000001ULL,
+    0x000a220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL,
+    0x0100004042101040ULL, 0x0004001004082820ULL, 0x0010000810010048ULL,
+    0x1014004208081300ULL, 0x2080818802044202ULL, 0x0040880c00a00100ULL,
+    0x0080400200522010ULL, 0x0001000188180b04ULL, 0x0080249202020204ULL,
+    0x1004400004100410ULL, 0x00013100a0022206ULL, 0x2148500001040080ULL,
+    0x4241080011004300ULL, 0x4020848004002000ULL, 0x10101380d1004100ULL,
+    0x0008004422020284ULL, 0x01010a1041008080ULL, 0x0808080400082121ULL,
+    0x0808080400082121ULL, 0x0091128200100c00ULL, 0x0202200802010104ULL,
+    0x8c0a020200440085ULL, 0x01a0008080b10040ULL, 0x0889520080122800ULL,
+    0x100902022202010aULL, 0x04081a0816002000ULL, 0x0000681208005000ULL,
+    0x8170840041008802ULL, 0x0a00004200810805ULL, 0x0830404408210100ULL,
+    0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+    0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440a210428ULL,
+    0x0008240020880021ULL, 0x0400002012048200ULL, 0x00ac102001210220ULL,
+    0x0220021002009900ULL, 0x84440c080a013080ULL, 0x0001008044200440ULL,
+    0x0004c04410841000ULL, 0x2000500104011130ULL, 0x1a0c010011c20229ULL,
+    0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822c08200ULL,
+    0x48081010008a2a80ULL
+};
+static const Bitboard Rook_magic_numbers[NUM_SQUARES] = {
+    0x0880004000108025ULL, 0x8040004010002008ULL, 0x2080200010008008ULL,
+    0x1100100008210004ULL, 0xc200209084020008ULL, 0x2100010004000208ULL,
+    0x0400081000822421ULL, 0x0200010422048844ULL, 0x0800800080400024ULL,
+    0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+    0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL,
+    0x4040800080004100ULL, 0x0040048001458024ULL, 0x00a0004000205000ULL,
+    0x3100808010002000ULL, 0x4825010010000820ULL, 0x5004808008000401ULL,
+    0x2024818004000a00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+    0x0080400880008421ULL, 0x4062220600410280ULL, 0x010a004a00108022ULL,
+    0x0000100080080080ULL, 0x0021000500080010ULL, 0x0044000202001008ULL,
+    0x0000100400080102ULL, 0xc020128200040545ULL, 0x0080002000400040ULL,
+    0x0000804000802004ULL, 0x0000120022004080ULL, 0x010a386103001001ULL,
+    0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL,
+    0x000000490a000084ULL, 0x0080002000504000ULL, 0x200020005000c000ULL,
+    0x0012088020420010ULL, 0x0010010080080800ULL, 0x0085001008010004ULL,
+    0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+    0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL,
+    0x2008100208028080ULL, 0x5000850800910100ULL, 0x8402019004680200ULL,
+    0x0120911028020400ULL, 0x0000008044010200ULL, 0x0020850200244012ULL,
+    0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040a100021ULL,
+    0x000200282410a102ULL, 0x000200282410a102ULL, 0x000200282410a102ULL,
+    0x4048240043802106ULL
+};
+
+/* Return the number of the lowest square in squares, which must not be empty. */
+unsigned
+first_square(Bitboard squares)
+{
+#if defined(__GNUC__)
+    return (unsigned) __builtin_ctzll(squares);
+#else
+    unsigned square = 0;
+
+    while ((squares & 1) == 0) {
+        squares >>= 1;
+        square++;
+    }
+    return square;
+#endif
+}
+
+/* Return the number of squares in squares. */
+unsigned
+count_squares(Bitboard squares)
+{
+#if defined(__GNUC__)
+    return (unsigned) __builtin_popcountll(squares);
+#else
+    unsigned count = 0;
+
+    while (squares != 0) {
+        squares &= squares - 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+/* Return the square at the given offsets from square, as a bitboard,
+ * or an empty bitboard if that is off the board.
+ */
+static Bitboard
+offset_square(unsigned square, int rank_offset, int col_offset)
+{
+    int rank = (int) (square / BOARDSIZE) + rank_offset;
+    int col = (int) (square % BOARDSIZE) + col_offset;
+
+    if (rank >= 0 && rank < BOARDSIZE && col >= 0 && col < BOARDSIZE) {
+        return SQUARE_BIT(rank * BOARDSIZE + col);
+    }
+    else {
+        return 0;
+    }
+}
+
+/* Return the squares reached from square by each of the steps. */
+static Bitboard
+step_attacks(unsigned square, const int steps[][2], unsigned num_steps)
+{
+    Bitboard attacks = 0;
+
+    for (unsigned ix = 0; ix < num_steps; ix++) {
+        attacks |= offset_square(square, steps[ix][0], steps[ix][1]);
+    }
+    return attacks;
+}
+
+/* Return the squares reached from square along the four directions,
+ * up to and including the first occupied square in each.
+ * This is only used to set up the tables.
+ */
+static Bitboard
+sliding_attacks(unsigned square, const int directions[][2], Bitboard occupied)
+{
+    Bitboard attacks = 0;
+
+    for (unsigned ix = 0; ix < 4; ix++) {
+        int rank = (int) (square / BOARDSIZE) + directions[ix][0];
+        int col = (int) (square % BOARDSIZE) + directions[ix][1];
+
+        while (rank >= 0 && rank < BOARDSIZE && col >= 0 && col < BOARDSIZE) {
+            Bitboard bit = SQUARE_BIT(rank * BOARDSIZE + col);
+
+            attacks |= bit;
+            if ((occupied & bit) != 0) {
+                break;
+            }
+            rank += directions[ix][0];
+            col += directions[ix][1];
+        }
+    }
+    return attacks;
+}
+
+static unsigned
+magic_index(const Magic *magic, Bitboard occupied)
+{
+    return (unsigned) (((occupied & magic->mask) * magic->magic) >> magic->shift);
+}
+
+/* Set up the magic of each square for the slider moving in
+ * the given directions, and fill in its part of the table of attacks.
+ */
+static void
+init_magics(Magic magics[], const Bitboard magic_numbers[], Bitboard table[],
+        const int directions[][2])
+{
+    Bitboard *attacks = table;
+
+    for (unsigned square = 0; square < NUM_SQUARES; square++) {
+        Magic *magic = &magics[square];
+        Bitboard edges =
+                ((FIRST_RANK_SQUARES | LAST_RANK_SQUARES) &
+                    ~(FIRST_RANK_SQUARES << (square / BOARDSIZE * BOARDSIZE))) |
+                ((FIRST_COL_SQUARES | LAST_COL_SQUARES) &
+                    ~(FIRST_COL_SQUARES << (square % BOARDSIZE)));
+        Bitboard subset = 0;
+        unsigned size = 0;
+
+        magic->mask = sliding_attacks(square, directions, 0) & ~edges;
+        magic->magic = magic_numbers[square];
+        magic->shift = NUM_SQUARES - count_squares(magic->mask);
+        magic->attacks = attacks;
+
+        /* Enumerate every subset of the mask. */
+        do {
+            magic->attacks[magic_index(magic, subset)] =
+                    sliding_attacks(square, directions, subset);
+            size++;
+            subset = (subset - magic->mask) & magic->mask;
+        } while (subset != 0);
+        attacks += size;
+    }
+}
+
+static Bitboard
+bishop_attacks(unsigned square, Bitboard occupied)
+{
+    const Magic *magic = &Bishop_magics[square];
+
+    return magic->attacks[magic_index(magic, occupied)];
+}
+
+static Bitboard
+rook_attacks(unsigned square, Bitboard occupied)
+{
+    const Magic *magic = &Rook_magics[square];
+
+    return magic->attacks[magic_index(magic, occupied)];
+}
+
+/* Set up the attack tables. */
+void
+init_bitboards(void)
+{
+    static Boolean initialised = FALSE;
+
+    if (initialised) {
+        return;
+    }
+    initialised = TRUE;
+
+    for (unsigned square = 0; square < NUM_SQUARES; square++) {
+        Knight_attacks[square] = step_attacks(square, Knight_steps, 8);
+        King_attacks[square] = step_attacks(square, King_steps, 8);
+        Pawn_attacks[WHITE][square] = offset_square(square, 1, -1) | offset_square(square, 1, 1);
+        Pawn_attacks[BLACK][square] = offset_square(square, -1, -1) | offset_square(square, -1, 1);
+    }
+    init_magics(Bishop_magics, Bishop_magic_numbers, Bishop_table, Bishop_directions);
+    init_magics(Rook_magics, Rook_magic_numbers, Rook_table, Rook_directions);
+
+    for (unsigned from = 0; from < NUM_SQUARES; from++) {
+        for (unsigned to = 0; to < NUM_SQUARES; to++) {
+            Bitboard ends = SQUARE_BIT(from) | SQUARE_BIT(to);
+
+            if (from == to) {
+                /* Not a line. */
+            }
+            else if ((bishop_attacks(from, 0) & SQUARE_BIT(to)) != 0) {
+                Between[from][to] = bishop_attacks(from, SQUARE_BIT(to)) &
+                        bishop_attacks(to, SQUARE_BIT(from));
+                Line[from][to] = (bishop_attacks(from, 0) & bishop_attacks(to, 0)) | ends;
+            }
+            else if ((rook_attacks(from, 0) & SQUARE_BIT(to)) != 0) {
+                Between[from][to] = rook_attacks(from, SQUARE_BIT(to)) &
+                        rook_attacks(to, SQUARE_BIT(from));
+                Line[from][to] = (rook_attacks(from, 0) & rook_attacks(to, 0)) | ends;
+            }
+        }
+    }
+}
+
+/* Set the bitboards of board from its board[][] array. */
+void
+set_bitboards(Board *board)
+{
+    for (Piece piece = OFF; piece < NUM_PIECE_VALUES; piece++) {
+        board->piece_squares[piece] = 0;
+    }
+    board->colour_squares[BLACK] = board->colour_squares[WHITE] = 0;
+
+    for (unsigned square = 0; square < NUM_SQUARES; square++) {
+        Piece coloured_piece = board->board[HEDGE + square / BOARDSIZE][HEDGE + square % BOARDSIZE];
+
+        if (coloured_piece != EMPTY && coloured_piece != OFF) {
+            board->piece_squares[EXTRACT_PIECE(coloured_piece)] |= SQUARE_BIT(square);
+            board->colour_squares[EXTRACT_COLOUR(coloured_piece)] |= SQUARE_BIT(square);
+        }
+    }
+}
+
+/* Return the squares attacked by piece of the given colour on square.
+ * Only pawn attacks depend on the colour.
+ */
+Bitboard
+piece_attacks(Piece piece, Colour colour, unsigned square, Bitboard occupied)
+{
+    switch (piece) {
+        case PAWN:
+            return Pawn_attacks[colour][square];
+        case KNIGHT:
+            return Knight_attacks[square];
+        case BISHOP:
+            return bishop_attacks(square, occupied);
+        case ROOK:
+            return rook_attacks(square, occupied);
+        case QUEEN:
+            return bishop_attacks(square, occupied) | rook_attacks(square, occupied);
+        case KING:
+            return King_attacks[square];
+        default:
+            return 0;
+    }
+}
+
+/* Return the pieces of the given colour that attack square when
+ * the occupied squares are those given.
+ */
+Bitboard
+attackers_of(const Board *board, unsigned square, Colour colour, Bitboard occupied)
+{
+    const Bitboard *pieces = board->piece_squares;
+
+    return ((Pawn_attacks[OPPOSITE_COLOUR(colour)][square] & pieces[PAWN]) |
+            (Knight_attacks[square] & pieces[KNIGHT]) |
+            (King_attacks[square] & pieces[KING]) |
+            (bishop_attacks(square, occupied) & (pieces[BISHOP] | pieces[QUEEN])) |
+            (rook_attacks(square, occupied) & (pieces[ROOK] | pieces[QUEEN]))) &
+            board->colour_squares[colour];
+}
+
+/* Find the checks on, and the pins against, the king of the given colour. */
+void
+find_king_safety(const Board *board, Colour colour, KingSafety *safety)
+{
+    Colour opponent = OPPOSITE_COLOUR(colour);
+    unsigned king_square = colour == WHITE ?
+            SQUARE(board->WKingCol, board->WKingRank) :
+            SQUARE(board->BKingCol, board->BKingRank);
+
+    safety->king_square = king_square;
+    safety->king_present = (board->piece_squares[KING] & board->colour_squares[colour] &
+            SQUARE_BIT(king_square)) != 0;
+    safety->checkers = 0;
+    safety->pinned = 0;
+    if (safety->king_present) {
+        const Bitboard *pieces = board->piece_squares;
+        Bitboard occupied = board->colour_squares[WHITE] | board->colour_squares[BLACK];
+        /* The opponent's sliders that would attack the king on an empty board. */
+        Bitboard snipers = ((rook_attacks(king_square, 0) & (pieces[ROOK] | pieces[QUEEN])) |
+                (bishop_attacks(king_square, 0) & (pieces[BISHOP] | pieces[QUEEN]))) &
+                board->colour_squares[opponent];
+
+        while (snipers != 0) {
+            Bitboard blockers = Between[king_square][first_square(snipers)] & occupied;
+
+            if (blockers != 0 && (blockers & (blockers - 1)) == 0) {
+                safety->pinned |= blockers & board->colour_squares[colour];
+            }
+            snipers &= snipers - 1;
+        }
+        safety->checkers = attackers_of(board, king_square, opponent, occupied);
+    }
+}
+
+/* Return TRUE if colour's piece may move from from to to without
+ * leaving its king in check. safety must have been found for board,
+ * with the king present.
+ * The position is taken to be as make_move() would leave it, so the
+ * en-passant square is captured by any pawn moving to it.
+ */
+Boolean
+move_leaves_king_safe(const Board *board, Colour colour, const KingSafety *safety,
+        Piece piece, unsigned from, unsigned to)
+{
+    Colour opponent = OPPOSITE_COLOUR(colour);
+    Bitboard from_bit = SQUARE_BIT(from);
+    Bitboard to_bit = SQUARE_BIT(to);
+    Bitboard occupied = board->colour_squares[WHITE] | board->colour_squares[BLACK];
+
+    if (piece == KING) {
+        /* The king must not be attacked where it lands, including along
+         * a line that it currently blocks itself.
+         */
+        occupied = (occupied & ~from_bit) | to_bit;
+        return (attackers_of(board, to, opponent, occupied) & ~to_bit) == 0;
+    }
+    else if (piece == PAWN && board->EnPassant &&
+            to == SQUARE(board->ep_col, board->ep_rank)) {
+        /* Removing the captured pawn as well may expose the king
+         * along a rank, so try the resulting position.
+         */
+        unsigned captured = colour == WHITE ? to - BOARDSIZE : to + BOARDSIZE;
+        Bitboard captured_bit = SQUARE_BIT(captured);
+
+        occupied = (occupied & ~from_bit & ~captured_bit) | to_bit;
+        return (attackers_of(board, safety->king_square, opponent, occupied) &
+                ~(to_bit | captured_bit)) == 0;
+    }
+    else if ((safety->checkers & (safety->checkers - 1)) != 0) {
+        /* Only a king move can escape a double check, except perhaps in
+         * an illegal position set up from a FEN string, so try it.
+         */
+        occupied = (occupied & ~from_bit) | to_bit;
+        return (attackers_of(board, safety->king_square, opponent, occupied) & ~to_bit) == 0;
+    }
+    else if (safety->checkers != 0 &&
+            ((Between[safety->king_square][first_square(safety->checkers)] |
+                safety->checkers) & to_bit) == 0) {
+        /* Neither blocks nor captures the single piece giving check. */
+        return FALSE;
+    }
+    else if ((safety->pinned & from_bit) != 0 &&
+            (Line[safety->king_square][from] & to_bit) == 0) {
+        /* Leaves the line of the pin. */
+        return FALSE;
+    }
+    else {
+        return TRUE;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+        /* Attack tables and the legality tests based on the
+         * bitboards of a Board.
+         */
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#define NUM_SQUARES (BOARDSIZE * BOARDSIZE)
+
+/* Conversions between algebraic or board[][] coordinates and
+ * bitboard square numbers.
+ */
+#define SQUARE(col, rank) ((unsigned) (((rank) - FIRSTRANK) * BOARDSIZE + ((col) - FIRSTCOL)))
+#define BOARD_SQUARE(r, c) ((unsigned) (((r) - HEDGE) * BOARDSIZE + ((c) - HEDGE)))
+#define SQUARE_COL(square) ((Col) (FIRSTCOL + (square) % BOARDSIZE))
+#define SQUARE_RANK(square) ((Rank) (FIRSTRANK + (square) / BOARDSIZE))
+#define SQUARE_BIT(square) (((Bitboard) 1) << (square))
+
+/* What is known about the safety of a king before one of its
+ * side's moves is made, so that each move may be tested cheaply.
+ */
+typedef struct {
+    /* Whether the king is on the square recorded for it in the Board.
+     * If not, as may be the case in a position set up from a FEN
+     * string, none of the rest is meaningful.
+     */
+    Boolean king_present;
+    unsigned king_square;
+    /* The opponent's pieces giving check. */
+    Bitboard checkers;
+    /* The king's own pieces that may only move along the line
+     * between the king and an opponent's piece.
+     */
+    Bitboard pinned;
+} KingSafety;
+
+void init_bitboards(void);
+void set_bitboards(Board *board);
+unsigned first_square(Bitboard squares);
+unsigned count_squares(Bitboard squares);
+Bitboard piece_attacks(Piece piece, Colour colour, unsigned square, Bitboard occupied);
+Bitboard attackers_of(const Board *board, unsigned square, Colour colour, Bitboard occupied);
+void find_king_safety(const Board *board, Colour colour, KingSafety *safety);
+Boolean move_leaves_king_safe(const Board *board, Colour colour, const KingSafety *safety,
+                Piece piece, unsigned from, unsigned to);
+#endif	// BITBOARD_H
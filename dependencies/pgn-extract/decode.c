@@ -34,6 +34,7 @@
 #include <string.h>
 #include "bool.h"
 #include "mymalloc.h"
+#include "arena.h"
 #include "defs.h"
 #include "typedef.h"
 #include "decode.h"
@@ -132,7 +133,7 @@ is_check(char c)
 Move *
 new_move_structure(void)
 {
-    Move *move = (Move *) malloc_or_die(sizeof (Move));
+    Move *move = (Move *) game_malloc(sizeof (Move));
 
     move->terminating_result = NULL;
     move->piece_to_move = EMPTY;
@@ -142,6 +143,8 @@ new_move_structure(void)
     move->epd = NULL;
     move->fen_suffix = NULL;
     move->zobrist = ~0;
+    move->forced = FALSE;
+    move->book = FALSE;
     move->evaluation = 0;
     move->NAGs = NULL;
     move->comment_list = NULL;
@@ -85,6 +85,9 @@ typedef char Col;
  */
 typedef uint64_t HashCode;
 
+/* A set of squares, one bit per square. */
+typedef uint64_t Bitboard;
+
 typedef struct {
     Piece board[HEDGE+BOARDSIZE+HEDGE][HEDGE+BOARDSIZE+HEDGE];
     /* Who has the next move. */
@@ -119,6 +122,12 @@ typedef struct {
     uint64_t zobrist;
     /* The half-move clock since the last pawn move or capture. */
     unsigned halfmove_clock;
+    /* The squares occupied by each kind of piece and by each colour,
+     * kept in step with board for the move generator and the check
+     * tests in map.c. Bit 0 is a1, bit 7 is h1 and bit 63 is h8.
+     */
+    Bitboard piece_squares[NUM_PIECE_VALUES];
+    Bitboard colour_squares[2];
 } Board;
 
 /* Define a type that can be used to create a list of possible source
@@ -147,6 +156,9 @@ typedef struct move_pair {
  */
 #define NULL_MOVE_STRING ("--")
 
+/* A small size for formatted move numbers. */
+#define FORMATTED_NUMBER_SIZE (20)
+
 
 #endif	// DEFS_H
 
@@ -52,6 +52,18 @@ static unsigned maximum_half_moves = ECO_HALF_MOVE_LIMIT;
 #define ECO_TABLE_SIZE 4096
 static EcoLog **EcoTable;
 
+/* Define a table to hold the hash values of every position
+ * reached along the ECO lines, not only their final ones.
+ * This is used to find where a game leaves the known lines.
+ */
+typedef struct EcoPosition {
+    HashCode hash_value;
+    struct EcoPosition *next;
+} EcoPosition;
+
+#define ECO_POSITION_TABLE_SIZE 8192
+static EcoPosition **EcoPositionTable;
+
 #if INCLUDE_UNUSED_FUNCTIONS
 
 static void
@@ -138,7 +150,45 @@ void initEcoTable(void)
         for (i = 0; i < ECO_TABLE_SIZE; i++) {
             EcoTable[i] = NULL;
         }
+        EcoPositionTable = (EcoPosition **)
+                malloc_or_die(ECO_POSITION_TABLE_SIZE * sizeof (EcoPosition *));
+        for (i = 0; i < ECO_POSITION_TABLE_SIZE; i++) {
+            EcoPositionTable[i] = NULL;
+        }
+    }
+}
+
+/* Record that hash_value is a position on one of the ECO lines. */
+void
+save_eco_position(HashCode hash_value)
+{
+    if (!is_eco_position(hash_value)) {
+        unsigned ix = hash_value % ECO_POSITION_TABLE_SIZE;
+        EcoPosition *entry = (EcoPosition *) malloc_or_die(sizeof (*entry));
+
+        entry->hash_value = hash_value;
+        entry->next = EcoPositionTable[ix];
+        EcoPositionTable[ix] = entry;
+    }
+}
+
+/* Return TRUE if hash_value is a position on one of the ECO lines,
+ * by whichever order of moves it was reached.
+ */
+Boolean
+is_eco_position(HashCode hash_value)
+{
+    if (EcoPositionTable != NULL) {
+        EcoPosition *entry;
+
+        for (entry = EcoPositionTable[hash_value % ECO_POSITION_TABLE_SIZE];
+                entry != NULL; entry = entry->next) {
+            if (entry->hash_value == hash_value) {
+                return TRUE;
+            }
+        }
     }
+    return FALSE;
 }
 
 /* Enter the ECO details of game into EcoTable.
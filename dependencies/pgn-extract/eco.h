@@ -46,6 +46,8 @@ Boolean add_ECO(Game game_details);
 FILE *open_eco_output_file(EcoDivision ECO_level,const char *eco);
 void initEcoTable(void);
 void save_eco_details(Game game_details,unsigned number_of_moves);
+void save_eco_position(HashCode hash_value);
+Boolean is_eco_position(HashCode hash_value);
 
 #endif	// ECO_H
 
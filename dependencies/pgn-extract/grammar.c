@@ -39,6 +39,7 @@
 #include "end.h"
 #include "grammar.h"
 #include "hashing.h"
+#include "arena.h"
 
 static TokenType current_symbol = NO_TOKEN;
 
@@ -48,7 +49,7 @@ static TokenType current_symbol = NO_TOKEN;
  */
 static unsigned RAV_level = 0;
 
-/* How often to report processing rate. */
+/* How often to report processing rate, or 0 for never. */
 static unsigned PROGRESS_RATE = 1000;
 
 /* Retain details of the header of a game.
@@ -78,6 +79,7 @@ static Variation *parse_variant(void);
 static char *parse_result(void);
 
 static void setup_for_new_game(void);
+static void free_game(void);
 void free_tags(void);
 static void check_result(char **Tags, const char *terminating_result);
 static void deal_with_ECO_line(Move *move_list);
@@ -299,14 +301,12 @@ parse_opt_game_list(SourceFileType file_type)
         else {
             /* Unknown type. */
             free_tags();
-            free_move_list(move_list);
         }
+        free_game();
         move_list = NULL;
         setup_for_new_game();
     }
-    if(move_list != NULL) {
-        free_move_list(move_list);
-    }
+    free_game();
 }
 
 /* Parse a game and return a pointer to any valid list of moves
@@ -329,12 +329,11 @@ parse_game(Move **returned_move_list, unsigned long *start_line, unsigned long *
     current_symbol = skip_to_next_game(current_symbol);
     prefix_comment = parse_opt_comment_list();
     if (prefix_comment != NULL) {
-        /* Free this here, as it is hard to
+        /* Drop this here, as it is hard to
          * know whether it belongs to the game or the file.
          * It is better to put game comments after the tags.
          */
         /* something_found = TRUE; */
-        free_comment_list(prefix_comment);
         prefix_comment = NULL;
     }
     *start_line = get_line_number();
@@ -384,7 +383,6 @@ parse_game(Move **returned_move_list, unsigned long *start_line, unsigned long *
     }
     else {
         /* @@@ Nothing to attach the comment to. */
-        (void) free((void *) hanging_comment);
         hanging_comment = NULL;
         /*
          * Workaround for games with zero moves.
@@ -394,9 +392,6 @@ parse_game(Move **returned_move_list, unsigned long *start_line, unsigned long *
          * will have to be supplied from the tags.
          */
         check_result(GameHeader.Tags, result);
-        if (result != NULL) {
-            (void) free((void *) result);
-        }
         *returned_move_list = NULL;
     }
     return current_symbol != EOF_TOKEN;
@@ -643,7 +638,7 @@ static void
 parse_opt_NAG_list(Move *move_details)
 {
     while (current_symbol == NAG) {
-        Nag *details = (Nag *) malloc_or_die(sizeof(*details));
+        Nag *details = (Nag *) game_malloc(sizeof(*details));
         details->text = NULL;
         details->comments = NULL;
         details->next = NULL;
@@ -695,7 +690,7 @@ parse_variant(void)
         Move *moves;
 
         RAV_level++;
-        variation = (Variation *) malloc_or_die(sizeof (Variation));
+        variation = (Variation *) game_malloc(sizeof (Variation));
 
         current_symbol = next_token();
         prefix_comment = parse_opt_comment_list();
@@ -787,93 +782,25 @@ free_tags(void)
     }
 }
 
-/* Discard data from a gathered game. */
-void
-free_string_list(StringList *list)
-{
-    StringList *next;
-
-    while (list != NULL) {
-        next = list;
-        list = list->next;
-        if (next->str != NULL) {
-            (void) free((void *) next->str);
-        }
-        (void) free((void *) next);
-    }
-}
-
-void
-free_comment_list(CommentList *comment_list)
-{
-    while (comment_list != NULL) {
-        CommentList *this_comment = comment_list;
-
-        if (comment_list->comment != NULL) {
-            free_string_list(comment_list->comment);
-        }
-        comment_list = comment_list->next;
-        (void) free((void *) this_comment);
-    }
-}
-
+/* Release the moves, variations, NAGs and comments of the game
+ * just dealt with, all of which are allocated with game_malloc().
+ * If the lookahead symbol has a value then that belongs to the next
+ * game and is held in the same space, so it is left to be released
+ * along with that game.
+ */
 static void
-free_variation(Variation *variation)
+free_game(void)
 {
-    Variation *next;
-
-    while (variation != NULL) {
-        next = variation;
-        variation = variation->next;
-        if (next->prefix_comment != NULL) {
-            free_comment_list(next->prefix_comment);
-        }
-        if (next->suffix_comment != NULL) {
-            free_comment_list(next->suffix_comment);
-        }
-        if (next->moves != NULL) {
-            (void) free_move_list(next->moves);
-        }
-        (void) free((void *) next);
-    }
-}
-
-static void free_NAG_list(Nag *nag_list)
-{
-    while(nag_list != NULL) {
-        Nag *nextNAG = nag_list->next;
-        free_string_list(nag_list->text);
-        free_comment_list(nag_list->comments);
-        (void) free((void *) nag_list);
-        nag_list = nextNAG;
-    }
-}
-
-void
-free_move_list(Move *move_list)
-{
-    Move *nextMove;
-
-    while (move_list != NULL) {
-        nextMove = move_list;
-        move_list = move_list->next;
-        
-        free_NAG_list(nextMove->NAGs);
-        free_comment_list(nextMove->comment_list);
-        free_variation(nextMove->Variants);
-        
-        if (nextMove->epd != NULL) {
-            (void) free((void *) nextMove->epd);
-        }
-        if(nextMove->fen_suffix != NULL) {
-            (void) free((void *) nextMove->fen_suffix);
-            nextMove->fen_suffix = NULL;
-        }
-        if (nextMove->terminating_result != NULL) {
-            (void) free((void *) nextMove->terminating_result);
-        }
-        
-        (void) free((void *) nextMove);
+    GameHeader.prefix_comment = NULL;
+    switch (current_symbol) {
+        case MOVE:
+        case COMMENT:
+        case NAG:
+        case TERMINATING_RESULT:
+            break;
+        default:
+            free_game_space();
+            break;
     }
 }
 
@@ -886,7 +813,7 @@ save_string_list_item(StringList *list, const char *str)
     if (str != NULL && *str != '\0') {
         StringList *new_item;
 
-        new_item = (StringList *) malloc_or_die(sizeof (*new_item));
+        new_item = (StringList *) game_malloc(sizeof (*new_item));
         new_item->str = str;
         new_item->next = NULL;
         if (list == NULL) {
@@ -901,16 +828,6 @@ save_string_list_item(StringList *list, const char *str)
             tail->next = new_item;
         }
     }
-#if 1
-    /* This is almost certainly correct to avoid losing
-     * two bytes with malloc'd empty strings.
-     * No problems with valgrind but just being
-     * cautious.
-     */
-    else if(str != NULL) {
-        (void) free((void *) str);
-    }
-#endif
     return list;
 }
 
@@ -1166,26 +1083,29 @@ deal_with_game(Move *move_list, unsigned long start_line, unsigned long end_line
         }
     }
 
-    /* Game is finished with, so free everything. */
-    if (GameHeader.prefix_comment != NULL) {
-        free_comment_list(GameHeader.prefix_comment);
-    }
-    /* Ensure that the GameHeader's prefix comment is NULL for
-     * the next game.
+    /* Game is finished with, so free the tags.
+     * Its moves and comments are freed by free_game().
      */
-    GameHeader.prefix_comment = NULL;
-
     free_tags();
-    free_move_list(current_game.moves);
     if (current_game.position_counts != NULL) {
         free_position_count_list(current_game.position_counts);
         current_game.position_counts = NULL;
     }
-    if (GlobalState.verbosity != 0 && (GlobalState.num_games_processed % PROGRESS_RATE) == 0) {
+    if (GlobalState.verbosity != 0 && PROGRESS_RATE != 0 &&
+            (GlobalState.num_games_processed % PROGRESS_RATE) == 0) {
         fprintf(stderr, "Games: %lu\r", GlobalState.num_games_processed);
     }
 }
 
+/* Report the number of games processed every rate games,
+ * or never if rate is 0.
+ */
+void
+set_progress_rate(unsigned rate)
+{
+    PROGRESS_RATE = rate;
+}
+
 /*
  * Output the given game to the output file.
  * If GlobalState.split_variants then this will involve outputting 
@@ -1247,7 +1167,7 @@ split_variants(Game *game, FILE *outputfile, unsigned depth)
                         last_move = last_move->next;
                     }
                     if(last_move->terminating_result == NULL) {
-                        last_move->terminating_result = copy_string("*");
+                        last_move->terminating_result = game_copy_string("*");
                     }
                     /* Replace the main line with the variants. */
                     if(prev != NULL) {
@@ -1299,7 +1219,6 @@ split_variants(Game *game, FILE *outputfile, unsigned depth)
             }
             if(move->Variants != NULL) {
                 /* The variation can now be disposed of. */
-                free_variation(move->Variants);
                 move->Variants = NULL;
                 /* Restore the move replaced by its variants. */
                 if(prev != NULL) {
@@ -1349,17 +1268,10 @@ deal_with_ECO_line(Move *move_list)
         }
     }
 
-    /* Game is finished with, so free everything. */
-    if (GameHeader.prefix_comment != NULL) {
-        free_comment_list(GameHeader.prefix_comment);
-    }
-    /* Ensure that the GameHeader's prefix comment is NULL for
-     * the next game.
+    /* Game is finished with, so free the tags.
+     * Its moves and comments are freed by free_game().
      */
-    GameHeader.prefix_comment = NULL;
-
     free_tags();
-    free_move_list(current_game.moves);
 }
 
 /* If file_type == ECOFILE we are dealing with a file of ECO
@@ -42,6 +42,8 @@
 #include "lists.h"
 #include "decode.h"
 #include "lines.h"
+#include "scan.h"
+#include "arena.h"
 #include "grammar.h"
 #include "apply.h"
 #include "output.h"
@@ -72,6 +74,8 @@ static unsigned games_in_file = 0;
  * This is intialised in init_lex_tables.
  */
 static FILE *yyin = NULL;
+/* The lines of yyin, set up when the first of them is needed. */
+static LineReader *yyin_lines = NULL;
 
 /* Define space for holding matched tokens. */
 #define MAX_YYTEXT 100
@@ -114,6 +118,7 @@ init_list_of_known_tags(void)
     TagList[BLACK_TYPE_TAG] = "BlackType";
     TagList[BLACK_USCF_TAG] = "BlackUSCF";
     TagList[BOARD_TAG] = "Board";
+    TagList[BOOK_DEPTH_TAG] = "BookDepth";
     TagList[DATE_TAG] = "Date";
     TagList[ECO_TAG] = "ECO";
     TagList[PSEUDO_ELO_TAG] = "Elo";
@@ -226,6 +231,7 @@ init_lex_tables(void)
     ChTab['\0'] = EOS;
     ChTab['*'] = STAR;
     ChTab['-'] = DASH;
+    init_scanning();
 
     /* Operators allowed only in the tag file. */
     ChTab['<'] = OPERATOR;
@@ -316,6 +322,10 @@ gather_string(char *line, unsigned char *linep)
     Boolean end_of_string = FALSE;
 
     do {
+        /* Pass over the ordinary characters. */
+        const unsigned char *stop = scan_string(linep);
+        len += stop - linep;
+        linep = (unsigned char *) stop;
         ch = *linep++;
         len++;
         if (ch == '\\') {
@@ -462,6 +472,10 @@ gather_comment(char *line, unsigned char *linep)
         /* Restart a new segment. */
         len = 0;
         do {
+            /* Pass over the text that cannot end the comment. */
+            const unsigned char *stop = scan_comment(linep);
+            len += stop - linep;
+            linep = (unsigned char *) stop;
             ch = *linep++;
             len++;
             if(ch == '{') {
@@ -504,7 +518,7 @@ gather_comment(char *line, unsigned char *linep)
                 start++;
             }
             /* Allocate space for the result. */
-            comment_str = (char *) malloc_or_die(end - start + 1);
+            comment_str = (char *) game_malloc(end - start + 1);
             strncpy(comment_str, (const char *) (str + start), end - start);
             comment_str[end - start] = '\0';
             current_comment = save_string_list_item(current_comment, comment_str);
@@ -520,7 +534,7 @@ gather_comment(char *line, unsigned char *linep)
     }
 
     /* Set up the structure to be returned. */
-    comment = (CommentList *) malloc_or_die(sizeof (*comment));
+    comment = (CommentList *) game_malloc(sizeof (*comment));
     comment->comment = current_comment;
     comment->next = NULL;
     yylval.comment = comment;
@@ -656,9 +670,7 @@ gather_tag(char *line, unsigned char *linep)
             linep = (unsigned char *) line;
         }
         if (line != NULL) {
-            while (ChTab[(unsigned) *linep] == WHITESPACE) {
-                linep++;
-            }
+            linep = (unsigned char *) skip_white_space(linep);
         }
     }    while ((line != NULL) && (ChTab[(unsigned) *linep] == '\0'));
 
@@ -765,8 +777,7 @@ get_next_symbol(void)
 
             switch (token) {
                 case WHITESPACE:
-                    while (ChTab[(unsigned) *linep] == WHITESPACE)
-                        linep++;
+                    linep = (unsigned char *) skip_white_space(linep);
                     token = NO_TOKEN;
                     break;
                 case TAG_START:
@@ -1053,15 +1064,7 @@ skip_to_next_game(TokenType token)
     if (skip_token(token)) {
         GlobalState.skipping_current_game = TRUE;
         do {
-            if (token == COMMENT) {
-                /* Free the space. */
-                if ((yylval.comment != NULL) &&
-                        (yylval.comment->comment != NULL)) {
-                    free_string_list(yylval.comment->comment);
-                    free((void *) yylval.comment);
-                    yylval.comment = NULL;
-                }
-            }
+            /* Anything skipped is freed along with the game. */
             token = next_token();
         } while (skip_token(token));
         GlobalState.skipping_current_game = FALSE;
@@ -1237,6 +1240,7 @@ add_filename_to_source_list(const char *filename, SourceFileType file_type)
 static Boolean
 open_input(const char *infile)
 {
+    close_input_lines();
     yyin = fopen(infile, "rb");
     if (yyin != NULL) {
         GlobalState.current_input_file = infile;
@@ -1248,6 +1252,45 @@ open_input(const char *infile)
     return yyin != NULL;
 }
 
+/* Use an already open stream as the input source.
+ * The stream remains owned by the caller and is not closed
+ * at its end.
+ */
+Boolean
+open_input_stream(FILE *fp, const char *name)
+{
+    close_input_lines();
+    yyin = fp;
+    if (yyin != NULL) {
+        GlobalState.current_input_file = name;
+        restart_lex_for_new_game();
+        games_in_file = 0;
+        reset_line_number();
+    }
+    return yyin != NULL;
+}
+
+/* Use part of an input file, already open as fp, as the only source
+ * of input. Its lines are numbered on from first_line, the number of
+ * lines of the file before it. This is for a worker of --jobs
+ * (parallel.c), which parses one part of one file, so yywrap() is
+ * left with no further files to open.
+ */
+Boolean
+open_input_part(FILE *fp, const char *name, unsigned long first_line)
+{
+    list_of_files.files = NULL;
+    list_of_files.num_files = 0;
+    if (open_input_stream(fp, name)) {
+        GlobalState.current_file_type = NORMALFILE;
+        line_number = first_line;
+        return TRUE;
+    }
+    else {
+        return FALSE;
+    }
+}
+
 /* Simple interface to open_input for the ECO file. */
 Boolean
 open_eco_file(const char *eco_file)
@@ -1279,6 +1322,7 @@ open_first_file(void)
 
     if (list_of_files.num_files == 0) {
         /* Use standard input. */
+        close_input_lines();
         yyin = stdin;
         GlobalState.current_input_file = "stdin";
         /* @@@ Should this be set?
@@ -1313,6 +1357,15 @@ input_file_name(unsigned file_number)
     }
 }
 
+/* Return the type of the file corresponding to the given
+ * file number, which must be in the list.
+ */
+SourceFileType
+input_file_type(unsigned file_number)
+{
+    return list_of_files.file_type[file_number];
+}
+
 /* Give some error information. */
 void
 print_error_context(FILE *fp)
@@ -1323,29 +1376,27 @@ print_error_context(FILE *fp)
     fprintf(fp, "Line number: %lu\n", line_number);
 }
 
-/* Make the given str accessible. */
+/* Make the given str accessible.
+ * It is a NAG or a result, so it belongs with the moves of the game.
+ */
 static void
 save_string(const char *str)
 {
-    const size_t len = strlen(str);
-    char *token;
-
-    token = (char *) malloc_or_die(len + 1);
-    strcpy(token, str);
-    yylval.token_string = token;
+    yylval.token_string = game_copy_string(str);
 }
 
-/* Return the next line of input from fp. */
+/* Return the next line of input from fp.
+ * It remains valid until the next call.
+ */
 char *
 next_input_line(FILE *fp)
-{ /* Retain each line in turn, so as to be able to free it. */
-    static char *line = NULL;
+{
+    char *line;
 
-    if (line != NULL) {
-        (void) free((void *) line);
+    if (yyin_lines == NULL) {
+        yyin_lines = new_line_reader(fp);
     }
-
-    line = read_line(fp);
+    line = next_line(yyin_lines);
 
     if (line != NULL) {
         line_number++;
@@ -1353,6 +1404,18 @@ next_input_line(FILE *fp)
     return line;
 }
 
+/* Finish with the lines of the current input.
+ * Must be called before a file read with next_input_line is closed.
+ */
+void
+close_input_lines(void)
+{
+    if (yyin_lines != NULL) {
+        close_line_reader(yyin_lines);
+        yyin_lines = NULL;
+    }
+}
+
 /* Handle the end of a file. */
 int
 yywrap(void)
@@ -1416,6 +1479,7 @@ reset_line_number(void)
 static void
 terminate_input(void)
 {
+    close_input_lines();
     if ((yyin != stdin) && (yyin != NULL)) {
         (void) fclose(yyin);
         yyin = NULL;
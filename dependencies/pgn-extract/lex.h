@@ -71,7 +71,6 @@ typedef struct {
 void yyerror(const char *s);
 void save_assessment(const char *assess);
 void restart_lex_for_new_game(void);
-void free_move_list(Move *move_list);
 void print_error_context(FILE *fp);
 void init_lex_tables(void);
 TokenType next_token(void);
@@ -79,14 +78,18 @@ TokenType skip_to_next_game(TokenType token);
 const char *tag_header_string(TagName tag);
 Boolean open_first_file(void);
 const char *input_file_name(unsigned file_number);
+SourceFileType input_file_type(unsigned file_number);
 unsigned current_file_number(void);
 Boolean open_eco_file(const char *eco_file);
+Boolean open_input_stream(FILE *fp, const char *name);
+Boolean open_input_part(FILE *fp, const char *name, unsigned long first_line);
 int yywrap(void);
 void add_filename_to_source_list(const char *filename,SourceFileType file_type);
 void add_filename_list_from_file(FILE *fp,SourceFileType file_type);
 unsigned long get_line_number(void);
 void reset_line_number(void);
 char *next_input_line(FILE *fp);
+void close_input_lines(void);
 LinePair gather_tag(char *line, unsigned char *linep);
 LinePair gather_string(char *line, unsigned char *linep);
 Boolean is_character_class(unsigned char ch, TokenType character_class);
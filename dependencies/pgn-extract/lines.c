@@ -19,6 +19,17 @@
  *  https://www.cs.kent.ac.uk/people/staff/djb/
  */
 
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#define MAP_INPUT_FILES
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -75,6 +86,288 @@ read_line(FILE *fpin)
     return line;
 }
 
+/* Input is read in blocks of READ_BLOCK_SIZE bytes, and regular files
+ * are mapped MAP_WINDOW bytes at a time.
+ */
+#define READ_BLOCK_SIZE (1 << 16)
+#define MAP_WINDOW (1 << 24)
+
+/* The source of the lines of a PGN file.
+ * The lines are returned in place, in the buffer or the mapped window,
+ * with their line end overwritten by '\0', so a line is neither
+ * copied nor allocated on its own. A mapping is private, so this
+ * never changes the file.
+ */
+struct LineReader {
+    FILE *fp;
+    /* The descriptor read with read(), or -1 if fp is read with fread(). */
+    int fd;
+    /* The input held: data[pos..size) is still to be returned. */
+    char *data;
+    size_t size;
+    size_t pos;
+    /* The length of a mapped window, or the size of the buffer
+     * not counting the extra byte for a final '\0'.
+     */
+    size_t capacity;
+    /* Whether the input ends at data[size]. */
+    Boolean eof;
+#ifdef MAP_INPUT_FILES
+    /* Whether data is a window of the file rather than a buffer. */
+    Boolean mapped;
+    /* The file position of data[0], and the size of the file. */
+    off_t offset;
+    off_t file_size;
+#endif
+    /* A copy of a final line of a mapped file that has no line end,
+     * as there may be no room for the '\0' after it.
+     */
+    char *last_line;
+};
+
+#ifdef MAP_INPUT_FILES
+/* Map the window of the file that starts at the page holding the
+ * position from, and is at least min_length bytes long from there.
+ * Return FALSE if it cannot be mapped.
+ */
+static Boolean
+map_window(LineReader *reader, off_t from, size_t min_length)
+{
+    off_t page = (off_t) sysconf(_SC_PAGESIZE);
+    off_t start = from - from % page;
+    size_t length = MAP_WINDOW;
+    void *window;
+
+    if (length < min_length + (size_t) (from - start)) {
+        length = min_length + (size_t) (from - start);
+    }
+    if ((off_t) length > reader->file_size - start) {
+        length = (size_t) (reader->file_size - start);
+    }
+    window = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                  reader->fd, start);
+    if (window == MAP_FAILED) {
+        return FALSE;
+    }
+    (void) posix_madvise(window, length, POSIX_MADV_SEQUENTIAL);
+    /* Release the previous window, along with the pages that the
+     * line ends were written to.
+     */
+    if (reader->data != NULL) {
+        (void) munmap((void *) reader->data, reader->capacity);
+    }
+    reader->data = (char *) window;
+    reader->capacity = length;
+    reader->size = length;
+    reader->pos = (size_t) (from - start);
+    reader->offset = start;
+    reader->eof = start + (off_t) length >= reader->file_size;
+    return TRUE;
+}
+#endif
+
+/* Read more of the input into the buffer, after the part of it
+ * still to be returned, which is moved to its start.
+ */
+static void
+read_block(LineReader *reader)
+{
+    size_t kept = reader->size - reader->pos;
+    long count;
+
+    if (reader->pos > 0) {
+        memmove(reader->data, reader->data + reader->pos, kept);
+        reader->pos = 0;
+        reader->size = kept;
+    }
+    if (reader->size == reader->capacity) {
+        /* A line longer than the buffer. */
+        reader->capacity *= 2;
+        reader->data = (char *) realloc_or_die((void *) reader->data,
+                reader->capacity + 1);
+    }
+#ifdef MAP_INPUT_FILES
+    if (reader->fd >= 0) {
+        /* read() returns what has arrived, so a pipe is not waited on
+         * any longer than a line needs.
+         */
+        do {
+            count = (long) read(reader->fd, reader->data + reader->size,
+                                reader->capacity - reader->size);
+        } while (count < 0 && errno == EINTR);
+    }
+    else {
+        count = (long) fread(reader->data + reader->size, 1,
+                             reader->capacity - reader->size, reader->fp);
+    }
+#else
+    count = (long) fread(reader->data + reader->size, 1,
+                         reader->capacity - reader->size, reader->fp);
+#endif
+    if (count > 0) {
+        reader->size += (size_t) count;
+    }
+    else {
+        reader->eof = TRUE;
+    }
+}
+
+/* Give the reader an empty buffer of capacity bytes. */
+static void
+allocate_buffer(LineReader *reader, size_t capacity)
+{
+    reader->capacity = capacity;
+    /* Room for the '\0' after a last line without a line end. */
+    reader->data = (char *) malloc_or_die(capacity + 1);
+    reader->size = 0;
+    reader->pos = 0;
+}
+
+/* Make more of the input available after data[pos]. */
+static void
+refill(LineReader *reader)
+{
+#ifdef MAP_INPUT_FILES
+    if (reader->mapped) {
+        off_t from = reader->offset + (off_t) reader->pos;
+        size_t kept = reader->size - reader->pos;
+
+        if (map_window(reader, from, 2 * kept)) {
+            return;
+        }
+        /* Carry on reading the file instead. */
+        (void) munmap((void *) reader->data, reader->capacity);
+        reader->mapped = FALSE;
+        allocate_buffer(reader, kept > READ_BLOCK_SIZE ? kept : READ_BLOCK_SIZE);
+        if (lseek(reader->fd, from, SEEK_SET) == (off_t) -1) {
+            reader->eof = TRUE;
+            return;
+        }
+    }
+#endif
+    read_block(reader);
+}
+
+/* Prepare to read the lines of fp, which must not have been read from
+ * already. fp remains open after close_line_reader.
+ * Regular files are mapped into memory, where the platform allows it.
+ */
+LineReader *
+new_line_reader(FILE *fp)
+{
+    LineReader *reader = (LineReader *) malloc_or_die(sizeof (*reader));
+
+    reader->fp = fp;
+    reader->fd = -1;
+    reader->data = NULL;
+    reader->size = 0;
+    reader->pos = 0;
+    reader->capacity = 0;
+    reader->eof = FALSE;
+    reader->last_line = NULL;
+#ifdef MAP_INPUT_FILES
+    reader->mapped = FALSE;
+    reader->fd = fileno(fp);
+    if (reader->fd >= 0) {
+        struct stat details;
+        off_t start = ftello(fp);
+
+        if (start >= 0 && fstat(reader->fd, &details) == 0 &&
+                S_ISREG(details.st_mode) && details.st_size > start) {
+            reader->file_size = details.st_size;
+            reader->mapped = map_window(reader, start, 0);
+        }
+    }
+    if (!reader->mapped) {
+        allocate_buffer(reader, READ_BLOCK_SIZE);
+    }
+#else
+    allocate_buffer(reader, READ_BLOCK_SIZE);
+#endif
+    return reader;
+}
+
+/* Return the next line, or NULL at the end of the input.
+ * The line is only valid until the next call.
+ * As with read_line, a line ends with '\n', '\r' or "\r\n".
+ */
+char *
+next_line(LineReader *reader)
+{
+    while (TRUE) {
+        char *start = reader->data + reader->pos;
+        size_t available = reader->size - reader->pos;
+        char *end = (char *) memchr(start, '\n', available);
+        char *cr = (char *) memchr(start, '\r',
+                end != NULL ? (size_t) (end - start) : available);
+
+        if (cr != NULL) {
+            if (cr + 1 == start + available && !reader->eof) {
+                /* See whether a '\n' follows it. */
+                refill(reader);
+                continue;
+            }
+            end = cr;
+        }
+        if (end != NULL) {
+            size_t skip = 1;
+
+            if (*end == '\r' && end + 1 < reader->data + reader->size &&
+                    end[1] == '\n') {
+                skip = 2;
+            }
+            *end = '\0';
+            reader->pos = (size_t) (end - reader->data) + skip;
+            return start;
+        }
+        else if (!reader->eof) {
+            refill(reader);
+        }
+        else if (available == 0) {
+            return NULL;
+        }
+        else {
+            /* A last line without a line end. */
+            reader->pos = reader->size;
+#ifdef MAP_INPUT_FILES
+            if (reader->mapped) {
+                if (reader->last_line != NULL) {
+                    (void) free((void *) reader->last_line);
+                }
+                reader->last_line = (char *) malloc_or_die(available + 1);
+                memcpy(reader->last_line, start, available);
+                reader->last_line[available] = '\0';
+                return reader->last_line;
+            }
+#endif
+            start[available] = '\0';
+            return start;
+        }
+    }
+}
+
+/* Release the reader, but not its stream. */
+void
+close_line_reader(LineReader *reader)
+{
+    if (reader->data != NULL) {
+#ifdef MAP_INPUT_FILES
+        if (reader->mapped) {
+            (void) munmap((void *) reader->data, reader->capacity);
+        }
+        else {
+            (void) free((void *) reader->data);
+        }
+#else
+        (void) free((void *) reader->data);
+#endif
+    }
+    if (reader->last_line != NULL) {
+        (void) free((void *) reader->last_line);
+    }
+    (void) free((void *) reader);
+}
+
 /* Return TRUE if line contains a non-space character, but
  * is not a comment line.
  */
@@ -22,7 +22,12 @@
 #ifndef LINES_H
 #define LINES_H
 
+typedef struct LineReader LineReader;
+
 char *read_line(FILE *fpin);
+LineReader *new_line_reader(FILE *fp);
+char *next_line(LineReader *reader);
+void close_line_reader(LineReader *reader);
 Boolean non_blank_line(const char *line);
 Boolean blank_line(const char *line);
 Boolean comment_line(const char *line);
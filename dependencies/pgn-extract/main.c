@@ -32,12 +32,17 @@
 #include "lex.h"
 #include "moves.h"
 #include "map.h"
+#include "bitboard.h"
 #include "lists.h"
 #include "output.h"
 #include "end.h"
 #include "grammar.h"
 #include "hashing.h"
 #include "argsfile.h"
+#include "eco.h"
+#include "polyglot.h"
+#include "parallel.h"
+#include "pgnextract.h"
 
 /* The maximum length of an output line.  This is conservatively
  * slightly smaller than the PGN export standard of 80.
@@ -76,6 +81,8 @@ StateInfo GlobalState = {
     FALSE,              /* check_tags */
     FALSE,              /* add_ECO (-e) */
     FALSE,              /* parsing_ECO_file (-e) */
+    FALSE,              /* add_book_depth_tag (--addbookdepth) */
+    FALSE,              /* drop_book_depth_tag */
     DONT_DIVIDE,        /* ECO_level (-E) */
     SAN,                /* output_format (-W) */
     MAX_LINE_LENGTH,    /* max_line_length (-w) */
@@ -106,9 +113,12 @@ StateInfo GlobalState = {
     0,                  /* maximum_matches */
     0,                  /* drop_ply_number (--dropply) */
     1,                  /* startply (--startply) */
+    1,                  /* jobs (--jobs) */
     FALSE,              /* output_FEN_string */
     FALSE,              /* add_FEN_comments (--fencomments) */
     FALSE,              /* add_hashcode_comments (--hashcomments) */
+    FALSE,              /* add_forced_comments (--forcedcomments) */
+    FALSE,              /* add_book_comments (--polyglotbook) */
     FALSE,              /* add_position_match_comments (--markmatches) */
     FALSE,              /* output_plycount (--plycount) */
     FALSE,              /* output_total_plycount (--totalplycount) */
@@ -153,6 +163,86 @@ init_default_global_state(void)
     set_output_line_length(MAX_LINE_LENGTH);
 }
 
+#ifdef PGN_EXTRACT_LIBRARY
+/* The settings in force after pgn_extract_init.
+ * Each conversion starts from these, as the output format
+ * arguments adjust several of the other fields.
+ */
+static StateInfo InitialState;
+
+void
+pgn_extract_init(void)
+{
+    init_default_global_state();
+    /* Only report errors. */
+    GlobalState.verbosity = 1;
+    init_game_header();
+    init_tag_lists();
+    init_hashtab();
+    init_bitboards();
+    init_lex_tables();
+    init_duplicate_hash_table();
+    InitialState = GlobalState;
+}
+
+int
+pgn_extract_load_eco(const char *eco_file)
+{
+    GlobalState = InitialState;
+    initEcoTable();
+    if (!open_eco_file(eco_file)) {
+        return 0;
+    }
+    GlobalState.parsing_ECO_file = TRUE;
+    yyparse(ECOFILE);
+    reset_line_number();
+    GlobalState.parsing_ECO_file = FALSE;
+    return 1;
+}
+
+int
+pgn_extract_load_book(const char *book_file)
+{
+    GlobalState = InitialState;
+    return open_polyglot_book(book_file) ? 1 : 0;
+}
+
+unsigned long
+pgn_extract_convert(FILE *infp, const char *input_name,
+                    FILE *outfp, const char *format,
+                    unsigned options)
+{
+    GlobalState = InitialState;
+    set_output_line_length(MAX_LINE_LENGTH);
+    process_argument(OUTPUT_FORMAT_ARGUMENT, format);
+    if (options & PGN_EXTRACT_HASH_COMMENTS) {
+        GlobalState.add_hashcode_comments = TRUE;
+    }
+    if (options & PGN_EXTRACT_FEN_COMMENTS) {
+        GlobalState.add_FEN_comments = TRUE;
+    }
+    if (options & PGN_EXTRACT_FORCED_COMMENTS) {
+        GlobalState.add_forced_comments = TRUE;
+    }
+    if (options & PGN_EXTRACT_BOOK_DEPTH) {
+        GlobalState.add_book_depth_tag = TRUE;
+    }
+    if (options & PGN_EXTRACT_NO_BOOK_DEPTH) {
+        GlobalState.drop_book_depth_tag = TRUE;
+    }
+    if (options & PGN_EXTRACT_BOOK_COMMENTS) {
+        GlobalState.add_book_comments = TRUE;
+    }
+    GlobalState.outputfile = outfp;
+
+    if (open_input_stream(infp, input_name)) {
+        yyparse(GlobalState.current_file_type);
+    }
+    fflush(outfp);
+    return GlobalState.num_games_matched;
+}
+
+#else
 int
 main(int argc, char *argv[])
 {
@@ -166,6 +256,8 @@ main(int argc, char *argv[])
     init_tag_lists();
     /* Prepare the hash tables for transposition detection. */
     init_hashtab();
+    /* Prepare the attack tables of the move generator. */
+    init_bitboards();
     /* Initialise the lexical analyser's tables. */
     init_lex_tables();
     /* Allow for some arguments. */
@@ -392,7 +484,7 @@ main(int argc, char *argv[])
     /* Prepare the hash tables for duplicate detection. */
     init_duplicate_hash_table();
 
-    if (GlobalState.add_ECO) {
+    if (GlobalState.add_ECO || GlobalState.add_book_depth_tag) {
         /* Read in a list of ECO lines in order to classify the games. */
         if (open_eco_file(GlobalState.eco_file)) {
             /* Indicate that the ECO file is currently being parsed. */
@@ -408,12 +500,15 @@ main(int argc, char *argv[])
         }
     }
 
-    /* Open up the first file as the source of input. */
-    if (!open_first_file()) {
-        exit(1);
-    }
+    /* Share the input between worker processes if --jobs allows it. */
+    if (!parse_in_parallel()) {
+        /* Open up the first file as the source of input. */
+        if (!open_first_file()) {
+            exit(1);
+        }
 
-    yyparse(GlobalState.current_file_type);
+        yyparse(GlobalState.current_file_type);
+    }
 
     /* @@@ I would prefer this to be somewhere else. */
     if (GlobalState.json_format &&
@@ -435,3 +530,4 @@ main(int argc, char *argv[])
     }
     return 0;
 }
+#endif
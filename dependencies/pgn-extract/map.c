@@ -33,6 +33,7 @@
 #include "map.h"
 #include "decode.h"
 #include "apply.h"
+#include "bitboard.h"
 
 /* Structures to hold the x,y displacements of the various
  * piece movements.
@@ -210,6 +211,26 @@ piece_is_colour(Piece coloured_piece, Colour colour)
     return EXTRACT_COLOUR(coloured_piece) == colour;
 }
 
+/* Put coloured_piece, which may be EMPTY, on the given square of board,
+ * keeping the bitboards in step.
+ */
+static void
+put_piece(Board *board, int r, int c, Piece coloured_piece)
+{
+    Piece occupant = board->board[r][c];
+    Bitboard bit = SQUARE_BIT(BOARD_SQUARE(r, c));
+
+    if (occupant != EMPTY) {
+        board->piece_squares[EXTRACT_PIECE(occupant)] &= ~bit;
+        board->colour_squares[EXTRACT_COLOUR(occupant)] &= ~bit;
+    }
+    if (coloured_piece != EMPTY) {
+        board->piece_squares[EXTRACT_PIECE(coloured_piece)] |= bit;
+        board->colour_squares[EXTRACT_COLOUR(coloured_piece)] |= bit;
+    }
+    board->board[r][c] = coloured_piece;
+}
+
 /* Make the given move. This is assumed to have been thoroughly
  * checked beforehand, and the from_ and to_ information to be
  * complete.  Update the board structure to reflect
@@ -301,7 +322,7 @@ make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col, Rank to_ran
             else if ((board->EnPassant) && (board->ep_rank == to_rank) &&
                     (board->ep_col == to_col)) {
                 /* This is an ep capture. Remove the intermediate pawn. */
-                board->board[RankConvert(to_rank) - 1][ColConvert(to_col)] = EMPTY;
+                put_piece(board, RankConvert(to_rank) - 1, ColConvert(to_col), EMPTY);
                 board->weak_hash_value ^= hash_lookup(to_col, to_rank - 1, PAWN, BLACK);
                 board->EnPassant = FALSE;
             }
@@ -318,7 +339,7 @@ make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col, Rank to_ran
             else if ((board->EnPassant) && (board->ep_rank == to_rank) &&
                     (board->ep_col == to_col)) {
                 /* This is an ep capture. Remove the intermediate pawn. */
-                board->board[RankConvert(to_rank) + 1][ColConvert(to_col)] = EMPTY;
+                put_piece(board, RankConvert(to_rank) + 1, ColConvert(to_col), EMPTY);
                 board->weak_hash_value ^= hash_lookup(to_col, to_rank + 1, PAWN, WHITE);
                 board->EnPassant = FALSE;
             }
@@ -335,7 +356,7 @@ make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col, Rank to_ran
     else {
         board->weak_hash_value ^= hash_lookup(from_col, from_rank, piece, colour);
     }
-    board->board[from_r][from_c] = EMPTY;
+    put_piece(board, from_r, from_c, EMPTY);
     if (board->board[to_r][to_c] != EMPTY) {
         /* Delete the removed piece from the hash value. */
         Piece coloured_piece = board->board[to_r][to_c];
@@ -392,7 +413,7 @@ make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col, Rank to_ran
         board->halfmove_clock++;
     }
     /* Place the piece at its destination. */
-    board->board[to_r][to_c] = MAKE_COLOURED_PIECE(colour, piece);
+    put_piece(board, to_r, to_c, MAKE_COLOURED_PIECE(colour, piece));
     /* Insert the moved piece into the hash value. */
     board->weak_hash_value ^= hash_lookup(to_col, to_rank, piece, colour);
     if(!board->EnPassant) {
@@ -405,11 +426,11 @@ make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col, Rank to_ran
         if (castling_rook_col != to_col) {
             /* It must be removed. */
             board->weak_hash_value ^= hash_lookup(castling_rook_col, from_rank, ROOK, colour);
-            board->board[from_r][ColConvert(castling_rook_col)] = EMPTY;
+            put_piece(board, from_r, ColConvert(castling_rook_col), EMPTY);
         }
         int rook_offset = (class == KINGSIDE_CASTLE ? -1 : 1);
         /* Place the rook at its destination. */
-        board->board[to_r][to_c + rook_offset] = MAKE_COLOURED_PIECE(colour, ROOK);
+        put_piece(board, to_r, to_c + rook_offset, MAKE_COLOURED_PIECE(colour, ROOK));
         board->weak_hash_value ^= hash_lookup(to_col + rook_offset, to_rank, ROOK, colour);
     }
 }
@@ -548,118 +569,70 @@ find_pawn_moves(Col from_col, Rank from_rank, Col to_col, Rank to_rank,
     return move_list;
 }
 
-/* Find knight moves to the given square. */
-MovePair *
-find_knight_moves(Col to_col, Rank to_rank, Colour colour, const Board *board)
+/* Return the squares of colour's pieces of the given kind, other than
+ * pawns, that attack to_col,to_rank and so might move there.
+ */
+static Bitboard
+find_sources(Piece piece, Colour colour, Col to_col, Rank to_rank, const Board *board)
+{
+    if ((RankConvert(to_rank) == 0) || (ColConvert(to_col) == 0)) {
+        /* The destination is incomplete. */
+        return 0;
+    }
+    else {
+        Bitboard occupied = board->colour_squares[WHITE] | board->colour_squares[BLACK];
+
+        return piece_attacks(piece, colour, SQUARE(to_col, to_rank), occupied) &
+                board->piece_squares[piece] & board->colour_squares[colour];
+    }
+}
+
+/* Return a list of the moves from each of sources to to_col,to_rank. */
+static MovePair *
+source_move_list(Bitboard sources, Col to_col, Rank to_rank)
 {
-    int to_r = RankConvert(to_rank);
-    int to_c = ColConvert(to_col);
-    unsigned ix;
     MovePair *move_list = NULL;
-    Piece target_piece = MAKE_COLOURED_PIECE(colour, KNIGHT);
 
-    /* Pick up pairs of offsets from to_r,to_c to look for a Knight of
-     * the right colour.
-     */
-    for (ix = 0; ix < 2 * NUM_KNIGHT_MOVES; ix += 2) {
-        int r = Knight_moves[ix] + to_r;
-        int c = Knight_moves[ix + 1] + to_c;
+    while (sources != 0) {
+        unsigned from = first_square(sources);
 
-        if (board->board[r][c] == target_piece) {
-            move_list = append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
-        }
+        move_list = append_move_pair(SQUARE_COL(from), SQUARE_RANK(from),
+                to_col, to_rank, move_list);
+        sources &= sources - 1;
     }
     return move_list;
 }
 
+/* Find knight moves to the given square. */
+MovePair *
+find_knight_moves(Col to_col, Rank to_rank, Colour colour, const Board *board)
+{
+    return source_move_list(find_sources(KNIGHT, colour, to_col, to_rank, board),
+            to_col, to_rank);
+}
+
 /* Find bishop moves to the given square. */
 MovePair *
 find_bishop_moves(Col to_col, Rank to_rank, Colour colour, const Board *board)
 {
-    int to_r = RankConvert(to_rank);
-    int to_c = ColConvert(to_col);
-    MovePair *move_list = NULL;
-    Piece target_piece = MAKE_COLOURED_PIECE(colour, BISHOP);
-
-    /* Pick up pairs of offsets from to_r,to_c to look for a Bishop of
-     * the right colour.
-     */
-    for (unsigned ix = 0; ix < 2 * NUM_BISHOP_MOVES; ix += 2) {
-        int r = to_r, c = to_c;
-
-        /* Work backwards from the destination to find a bishop of
-         * the right colour.
-         */
-        do {
-            r += Bishop_moves[ix];
-            c += Bishop_moves[ix + 1];
-        } while (board->board[r][c] == EMPTY);
-
-        if (board->board[r][c] == target_piece) {
-            move_list = append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
-        }
-    }
-    return move_list;
+    return source_move_list(find_sources(BISHOP, colour, to_col, to_rank, board),
+            to_col, to_rank);
 }
 
 /* Find rook moves to the given square. */
 MovePair *
 find_rook_moves(Col to_col, Rank to_rank, Colour colour, const Board *board)
 {
-    int to_r = RankConvert(to_rank);
-    int to_c = ColConvert(to_col);
-    MovePair *move_list = NULL;
-    Piece target_piece = MAKE_COLOURED_PIECE(colour, ROOK);
-
-    /* Pick up pairs of offsets from to_r,to_c to look for a Rook of
-     * the right colour.
-     */
-    for (unsigned ix = 0; ix < 2 * NUM_ROOK_MOVES; ix += 2) {
-        int r = to_r, c = to_c;
-
-        /* Work backwards from the destination to find a rook of
-         * the right colour.
-         */
-        do {
-            r += Rook_moves[ix];
-            c += Rook_moves[ix + 1];
-        } while (board->board[r][c] == EMPTY);
-
-        if (board->board[r][c] == target_piece) {
-            move_list = append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
-        }
-    }
-    return move_list;
+    return source_move_list(find_sources(ROOK, colour, to_col, to_rank, board),
+            to_col, to_rank);
 }
 
 /* Find queen moves to the given square. */
 MovePair *
 find_queen_moves(Col to_col, Rank to_rank, Colour colour, const Board *board)
 {
-    int to_r = RankConvert(to_rank);
-    int to_c = ColConvert(to_col);
-    MovePair *move_list = NULL;
-    Piece target_piece = MAKE_COLOURED_PIECE(colour, QUEEN);
-
-    /* Pick up pairs of offsets from to_r,to_c to look for a Queen of
-     * the right colour.
-     */
-    for (unsigned ix = 0; ix < 2 * NUM_QUEEN_MOVES; ix += 2) {
-        int r = to_r, c = to_c;
-
-        /* Work backwards from the destination to find a queen of
-         * the right colour.
-         */
-        do {
-            r += Queen_moves[ix];
-            c += Queen_moves[ix + 1];
-        } while (board->board[r][c] == EMPTY);
-
-        if (board->board[r][c] == target_piece) {
-            move_list = append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
-        }
-    }
-    return move_list;
+    return source_move_list(find_sources(QUEEN, colour, to_col, to_rank, board),
+            to_col, to_rank);
 }
 
 /* Find King moves to the given square. */
@@ -667,23 +640,18 @@ MovePair *
 find_king_moves(Col to_col, Rank to_rank, Colour colour, const Board *board)
 {
     int to_r = RankConvert(to_rank);
-    int to_c = ColConvert(to_col);
     MovePair *move_list = NULL;
     Piece target_piece = MAKE_COLOURED_PIECE(colour, KING);
+    Bitboard sources = find_sources(KING, colour, to_col, to_rank, board);
     /* Stop once the single King is found. */
     Boolean found = FALSE;
 
-    /* Pick up pairs of offsets from to_r,to_c to look for a King of
-     * the right colour.
-     */
-    for (unsigned ix = 0; ix < 2 * NUM_KING_MOVES && !found; ix += 2) {
-        int r = King_moves[ix] + to_r;
-        int c = King_moves[ix + 1] + to_c;
+    if (sources != 0) {
+        unsigned from = first_square(sources);
 
-        if (board->board[r][c] == target_piece) {
-            move_list = append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
-            found = TRUE;
-        }
+        move_list = append_move_pair(SQUARE_COL(from), SQUARE_RANK(from),
+                to_col, to_rank, move_list);
+        found = TRUE;
     }
     if(!found) {
         /* Check for possible Chess960 castling moves.
@@ -989,6 +957,7 @@ king_is_in_check(const Board *board, Colour king_colour)
     Col king_col;
     Rank king_rank;
     Colour opponent_colour = OPPOSITE_COLOUR(king_colour);
+    unsigned king_square;
 
     /* Find out where the king is now. */
     if (king_colour == WHITE) {
@@ -999,7 +968,19 @@ king_is_in_check(const Board *board, Colour king_colour)
         king_col = board->BKingCol;
         king_rank = board->BKingRank;
     }
-    /* Try and find one move that leaves this king in check.
+    king_square = SQUARE(king_col, king_rank);
+    if ((board->piece_squares[KING] & board->colour_squares[king_colour] &
+            SQUARE_BIT(king_square)) != 0) {
+        Bitboard occupied = board->colour_squares[WHITE] | board->colour_squares[BLACK];
+
+        if (attackers_of(board, king_square, opponent_colour, occupied) == 0) {
+            in_check = NOCHECK;
+        }
+    }
+    /* The king is missing from its square, which is possible in a
+     * position set up from a FEN string, so look for a move to the
+     * square instead.
+     * Try and find one move that leaves this king in check.
      * There is probably an optimal order for these tests but 
      * I don't know for sure what it is.
      * Try the pieces with greatest mobility first.
@@ -1007,7 +988,7 @@ king_is_in_check(const Board *board, Colour king_colour)
      * @@@ NB: Since a single move would be enough, this could
      * be made more efficient.
      */
-    if (find_single_queen_move(king_col, king_rank,
+    else if (find_single_queen_move(king_col, king_rank,
             opponent_colour, board)) {
         /* King is in check from a queen. */
     }
@@ -1044,6 +1025,30 @@ king_is_in_check(const Board *board, Colour king_colour)
     return in_check;
 }
 
+/* Return TRUE if colour's piece may move from from_col,from_rank
+ * to to_col,to_rank without leaving its own king in check.
+ * safety is that found for colour on board before the move.
+ */
+static Boolean
+move_is_legal(Piece piece, Colour colour, Col from_col, Rank from_rank,
+        Col to_col, Rank to_rank, const KingSafety *safety, const Board *board)
+{
+    if (safety->king_present) {
+        return move_leaves_king_safe(board, colour, safety, piece,
+                SQUARE(from_col, from_rank), SQUARE(to_col, to_rank));
+    }
+    else {
+        /* Make the move on a copy of the board and see whether the
+         * king is then in check.
+         */
+        Board copy_board = *board;
+
+        make_move(UNKNOWN_MOVE, from_col, from_rank, to_col, to_rank,
+                piece, colour, &copy_board);
+        return king_is_in_check(&copy_board, colour) == NOCHECK;
+    }
+}
+
 /* possibles contains a list of possible moves of piece.
  * NB: Elements of possibles might be freed by this function
  * so it is invalidated by the call.
@@ -1051,30 +1056,20 @@ king_is_in_check(const Board *board, Colour king_colour)
  * This function should exclude all of those moves of this piece
  * which leave its own king in check.  
  * The list of remaining legal moves is returned as result.
- * This function operates by looking for at least one reply by the
- * opponent that could capture the king of the given colour.
- * Only one such move needs to be found to invalidate one of the
- * possible moves.
+ * The checks on the king, and the pieces pinned against it, are
+ * found once for all of the possible moves.
  */
 MovePair *
 exclude_checks(Piece piece, Colour colour, MovePair *possibles, const Board *board)
-{   /* As this function is not called recursively, it should be
-     * safe to retain a single copy of the board on the stack without risking
-     * overflow. This has been a problem in the past with the PC version.
-     */
-    Board copy_board;
+{
     MovePair *valid_move_list = NULL;
     MovePair *move;
+    KingSafety safety;
 
-    /* For each possible move, make the move and see if it leaves the king
-     * in check.
-     */
+    find_king_safety(board, colour, &safety);
     for (move = possibles; move != NULL;) {
-        /* Take a copy of the board before playing this next move. */
-        copy_board = *board;
-        make_move(UNKNOWN_MOVE, move->from_col, move->from_rank,
-                move->to_col, move->to_rank, piece, colour, &copy_board);
-        if (king_is_in_check(&copy_board, colour) != NOCHECK) {
+        if (!move_is_legal(piece, colour, move->from_col, move->from_rank,
+                move->to_col, move->to_rank, &safety, board)) {
             MovePair *illegal_move = move;
             move = move->next;
             /* Free the illegal move. */
@@ -1100,25 +1095,17 @@ exclude_castling_across_checks(Col king_start_col, Col king_end_col,
         Colour colour, const Board *board)
 {
     Boolean Ok = TRUE;
-    MovePair *move = malloc_move();
     Rank rank = (colour == WHITE) ? FIRSTRANK : LASTRANK;
     int direction = king_end_col >= king_start_col ? 1 : -1;
     Col boundary = king_end_col + direction;
     Col to_col;
+    KingSafety safety;
 
+    find_king_safety(board, colour, &safety);
     /* Start where we are, because you can't castle out of check. */
     for (to_col = king_start_col; (to_col != boundary) && Ok; to_col += direction) {
-        move->from_col = king_start_col;
-        move->from_rank = rank;
-        move->to_col = to_col;
-        move->to_rank = rank;
-        move = exclude_checks(KING, colour, move, board);
-        if (move == NULL) {
-            Ok = FALSE;
-        }
-    }
-    if (move != NULL) {
-        free_move_pair(move);
+        Ok = move_is_legal(KING, colour, king_start_col, rank, to_col, rank,
+                &safety, board);
     }
     return Ok;
 }
@@ -1174,6 +1161,36 @@ exclude_moves(Piece piece, Colour colour, Col from_col, Rank from_rank,
     return move_list;
 }
 
+/* sources are the squares of colour's pieces of the given kind that
+ * might move to to_col,to_rank.
+ * Return those that are not excluded by non-null information in
+ * from_col or from_rank, and whose move does not leave the king in check.
+ */
+static Bitboard
+exclude_sources(Piece piece, Colour colour, Col from_col, Rank from_rank,
+        Col to_col, Rank to_rank, Bitboard sources, const Board *board)
+{
+    Bitboard legal_sources = 0;
+    KingSafety safety;
+
+    if (sources != 0) {
+        find_king_safety(board, colour, &safety);
+    }
+    while (sources != 0) {
+        unsigned from = first_square(sources);
+        Col col = SQUARE_COL(from);
+        Rank rank = SQUARE_RANK(from);
+
+        if (((from_col == 0) || (from_col == col)) &&
+                ((from_rank == 0) || (from_rank == rank)) &&
+                move_is_legal(piece, colour, col, rank, to_col, to_rank, &safety, board)) {
+            legal_sources |= SQUARE_BIT(from);
+        }
+        sources &= sources - 1;
+    }
+    return legal_sources;
+}
+
 /* Make a pawn move.
  * En-passant information in the original move text is not currently used
  * to disambiguate pawn moves.  E.g. with Black pawns on c4 and c5 after
@@ -1296,34 +1313,31 @@ knight_move(Move *move_details, Colour colour, Board *board)
     Rank to_rank = move_details->to_rank;
     int to_r = RankConvert(to_rank);
     int to_c = ColConvert(to_col);
-    MovePair *move_list = find_knight_moves(to_col, to_rank, colour, board);
+    Bitboard sources = exclude_sources(KNIGHT, colour, from_col, from_rank, to_col, to_rank,
+            find_sources(KNIGHT, colour, to_col, to_rank, board), board);
     /* Assume everything will be ok. */
     Boolean Ok = TRUE;
 
-    move_list = exclude_moves(KNIGHT, colour, from_col, from_rank, move_list, board);
-
-    if (move_list == NULL) {
+    if (sources == 0) {
         fprintf(GlobalState.logfile, "No knight move possible to %c%c.\n", to_col, to_rank);
         Ok = FALSE;
     }
-    else if (move_list->next == NULL) {
+    else if ((sources & (sources - 1)) == 0) {
         /* Only one possible.  Check for legality. */
         Piece occupant = board->board[to_r][to_c];
 
         if ((occupant == EMPTY) || piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
-            move_details->from_col = move_list->from_col;
-            move_details->from_rank = move_list->from_rank;
+            move_details->from_col = SQUARE_COL(first_square(sources));
+            move_details->from_rank = SQUARE_RANK(first_square(sources));
         }
         else {
             fprintf(GlobalState.logfile, "Knight destination square %c%c is illegal.\n",
                     to_col, to_rank);
             Ok = FALSE;
         }
-        free_move_pair(move_list);
     }
     else {
         fprintf(GlobalState.logfile, "Ambiguous knight move to %c%c.\n", to_col, to_rank);
-        free_move_pair_list(move_list);
         Ok = FALSE;
     }
     return Ok;
@@ -1341,34 +1355,31 @@ bishop_move(Move *move_details, Colour colour, Board *board)
     Rank to_rank = move_details->to_rank;
     int to_r = RankConvert(to_rank);
     int to_c = ColConvert(to_col);
-    MovePair *move_list = find_bishop_moves(to_col, to_rank, colour, board);
+    Bitboard sources = exclude_sources(BISHOP, colour, from_col, from_rank, to_col, to_rank,
+            find_sources(BISHOP, colour, to_col, to_rank, board), board);
     /* Assume that it is ok. */
     Boolean Ok = TRUE;
 
-    move_list = exclude_moves(BISHOP, colour, from_col, from_rank, move_list, board);
-
-    if (move_list == NULL) {
+    if (sources == 0) {
         fprintf(GlobalState.logfile, "No bishop move possible to %c%c.\n", to_col, to_rank);
         Ok = FALSE;
     }
-    else if (move_list->next == NULL) {
+    else if ((sources & (sources - 1)) == 0) {
         /* Only one possible.  Check for legality. */
         Piece occupant = board->board[to_r][to_c];
 
         if ((occupant == EMPTY) || piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
-            move_details->from_col = move_list->from_col;
-            move_details->from_rank = move_list->from_rank;
+            move_details->from_col = SQUARE_COL(first_square(sources));
+            move_details->from_rank = SQUARE_RANK(first_square(sources));
         }
         else {
             fprintf(GlobalState.logfile, "Bishop's destination square %c%c is illegal.\n",
                     to_col, to_rank);
             Ok = FALSE;
         }
-        free_move_pair(move_list);
     }
     else {
         fprintf(GlobalState.logfile, "Ambiguous bishop move to %c%c.\n", to_col, to_rank);
-        free_move_pair_list(move_list);
         Ok = FALSE;
     }
     return Ok;
@@ -1386,28 +1397,29 @@ rook_move(Move *move_details, Colour colour, Board *board)
     Rank to_rank = move_details->to_rank;
     int to_r = RankConvert(to_rank);
     int to_c = ColConvert(to_col);
-    MovePair *move_list = find_rook_moves(to_col, to_rank, colour, board);
+    Bitboard sources = find_sources(ROOK, colour, to_col, to_rank, board);
     /* Assume that it is ok. */
     Boolean Ok = TRUE;
 
-    if (move_list == NULL) {
+    if (sources == 0) {
         fprintf(GlobalState.logfile, "No rook move possible to %c%c.\n", to_col, to_rank);
         Ok = FALSE;
     }
     else {
-        move_list = exclude_moves(ROOK, colour, from_col, from_rank, move_list, board);
+        sources = exclude_sources(ROOK, colour, from_col, from_rank, to_col, to_rank,
+                sources, board);
 
-        if (move_list == NULL) {
+        if (sources == 0) {
             fprintf(GlobalState.logfile, "Indicated rook move is excluded.\n");
             Ok = FALSE;
         }
-        else if (move_list->next == NULL) {
+        else if ((sources & (sources - 1)) == 0) {
             /* Only one possible.  Check for legality. */
             Piece occupant = board->board[to_r][to_c];
 
             if ((occupant == EMPTY) || piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
-                move_details->from_col = move_list->from_col;
-                move_details->from_rank = move_list->from_rank;
+                move_details->from_col = SQUARE_COL(first_square(sources));
+                move_details->from_rank = SQUARE_RANK(first_square(sources));
             }
             else {
                 fprintf(GlobalState.logfile,
@@ -1415,11 +1427,9 @@ rook_move(Move *move_details, Colour colour, Board *board)
                         to_col, to_rank);
                 Ok = FALSE;
             }
-            free_move_pair(move_list);
         }
         else {
             fprintf(GlobalState.logfile, "Ambiguous rook move to %c%c.\n", to_col, to_rank);
-            free_move_pair_list(move_list);
             Ok = FALSE;
         }
     }
@@ -1438,34 +1448,31 @@ queen_move(Move *move_details, Colour colour, Board *board)
     Rank to_rank = move_details->to_rank;
     int to_r = RankConvert(to_rank);
     int to_c = ColConvert(to_col);
-    MovePair *move_list = find_queen_moves(to_col, to_rank, colour, board);
+    Bitboard sources = exclude_sources(QUEEN, colour, from_col, from_rank, to_col, to_rank,
+            find_sources(QUEEN, colour, to_col, to_rank, board), board);
     /* Assume that it is ok. */
     Boolean Ok = TRUE;
 
-    move_list = exclude_moves(QUEEN, colour, from_col, from_rank, move_list, board);
-
-    if (move_list == NULL) {
+    if (sources == 0) {
         fprintf(GlobalState.logfile, "No queen move possible to %c%c.\n", to_col, to_rank);
         Ok = FALSE;
     }
-    else if (move_list->next == NULL) {
+    else if ((sources & (sources - 1)) == 0) {
         /* Only one possible.  Check for legality. */
         Piece occupant = board->board[to_r][to_c];
 
         if ((occupant == EMPTY) || piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
-            move_details->from_col = move_list->from_col;
-            move_details->from_rank = move_list->from_rank;
+            move_details->from_col = SQUARE_COL(first_square(sources));
+            move_details->from_rank = SQUARE_RANK(first_square(sources));
         }
         else {
             fprintf(GlobalState.logfile, "Queen's destination square %c%c is illegal.\n",
                     to_col, to_rank);
             Ok = FALSE;
         }
-        free_move_pair(move_list);
     }
     else {
         fprintf(GlobalState.logfile, "Ambiguous queen move to %c%c.\n", to_col, to_rank);
-        free_move_pair_list(move_list);
         Ok = FALSE;
     }
     return Ok;
@@ -1937,7 +1944,6 @@ determine_move_details(Colour colour, Move *move_details, Board *board)
                             move_details->to_rank = alternative->to_rank;
                             move_details->piece_to_move =
                                     alternative->piece_to_move;
-                            free_move_list(alternative);
                             move_handled = TRUE;
                         }
                     }
@@ -2021,170 +2027,82 @@ determine_move_details(Colour colour, Move *move_details, Board *board)
     return Ok;
 }
 
-/* Generate a list of moves of a king or knight from from_col,from_rank.
- * This does not include castling for the king, because it is used
- * by the code that looks for ways to escape from check for which
- * castling is illegal, of course.
+/* Return the squares to which colour's pawn on from might move,
+ * whether or not that would leave the king in check.
  */
-static MovePair *
-generate_single_moves(Colour colour, Piece piece,
-        const Board *board, Col from_col, Rank from_rank)
+static Bitboard
+pawn_destinations(Colour colour, unsigned from, const Board *board)
 {
-    int from_r = RankConvert(from_rank);
-    int from_c = ColConvert(from_col);
-    unsigned ix;
-    MovePair *moves = NULL;
-    Colour target_colour = OPPOSITE_COLOUR(colour);
-    unsigned num_directions = piece == KING ? NUM_KING_MOVES : NUM_KNIGHT_MOVES;
-    const int *Piece_moves = piece == KING ? King_moves : Knight_moves;
-
-    /* Pick up pairs of offsets from from_r,from_c to look for an
-     * EMPTY square, or one containing a piece of OPPOSITE_COLOUR(colour).
-     */
-    for (ix = 0; ix < 2 * num_directions; ix += 2) {
-        int r = Piece_moves[ix] + from_r;
-        int c = Piece_moves[ix + 1] + from_c;
-        Piece occupant = board->board[r][c];
-        Boolean Ok = FALSE;
+    Bitboard occupied = board->colour_squares[WHITE] | board->colour_squares[BLACK];
+    Bitboard captures = piece_attacks(PAWN, colour, from, occupied);
+    Bitboard destinations;
 
-        if (occupant == OFF) {
-            /* Not a valid move. */
-        }
-        else if (board->board[r][c] == EMPTY) {
-            Ok = TRUE;
-        }
-        else if (EXTRACT_COLOUR(occupant) == target_colour) {
-            Ok = TRUE;
-        }
-        else {
-        }
-        if (Ok) {
-            /* Fill in the details, and add it to the list. */
-            moves = append_move_pair(from_col, from_rank, ToCol(c), ToRank(r), moves);
+    /* Try single step ahead, then two steps from the starting rank. */
+    if (colour == WHITE) {
+        destinations = (SQUARE_BIT(from) << BOARDSIZE) & ~occupied;
+        if (SQUARE_RANK(from) == FIRSTRANK + 1) {
+            destinations |= (destinations << BOARDSIZE) & ~occupied;
         }
     }
-    if (moves != NULL) {
-        moves = exclude_checks(piece, colour, moves, board);
-    }
-    return moves;
-}
-
-/* Generate a list of moves of a queen, rook or bishop from
- * from_col,from_rank.
- */
-static MovePair *
-generate_multiple_moves(Colour colour, Piece piece,
-        const Board *board, Col from_col, Rank from_rank)
-{
-    int from_r = RankConvert(from_rank);
-    int from_c = ColConvert(from_col);
-    unsigned ix;
-    MovePair *moves = NULL;
-    Colour target_colour = OPPOSITE_COLOUR(colour);
-    unsigned num_directions = piece == QUEEN ? NUM_QUEEN_MOVES :
-            piece == ROOK ? NUM_ROOK_MOVES : NUM_BISHOP_MOVES;
-    const int *Piece_moves = piece == QUEEN ? Queen_moves :
-            piece == ROOK ? Rook_moves : Bishop_moves;
-
-    /* Pick up pairs of offsets from from_r,from_c to look for an
-     * EMPTY square, or one containing a piece of OPPOSITE_COLOUR(colour).
-     */
-    for (ix = 0; ix < 2 * num_directions; ix += 2) {
-        int r = Piece_moves[ix] + from_r;
-        int c = Piece_moves[ix + 1] + from_c;
-        Piece occupant = board->board[r][c];
-
-        /* Include EMPTY squares as possible moves. */
-        while (occupant == EMPTY) {
-            /* Fill in the details, and add it to the list. */
-            moves = append_move_pair(from_col, from_rank, ToCol(c), ToRank(r), moves);
-            /* Move on to the next square in this direction. */
-            r += Piece_moves[ix];
-            c += Piece_moves[ix + 1];
-            occupant = board->board[r][c];
-        }
-        /* We have come up against an obstruction. */
-        if (occupant == OFF) {
-            /* Not a valid move. */
-        }
-        else if (EXTRACT_COLOUR(occupant) == target_colour) {
-            moves = append_move_pair(from_col, from_rank, ToCol(c), ToRank(r), moves);
-        }
-        else {
-            /* Should be a piece of our own colour. */
+    else {
+        destinations = (SQUARE_BIT(from) >> BOARDSIZE) & ~occupied;
+        if (SQUARE_RANK(from) == LASTRANK - 1) {
+            destinations |= (destinations >> BOARDSIZE) & ~occupied;
         }
     }
-    if (moves != NULL) {
-        moves = exclude_checks(piece, colour, moves, board);
+    /* Try the captures, including an en-passant capture. */
+    destinations |= captures & board->colour_squares[OPPOSITE_COLOUR(colour)];
+    if (board->EnPassant) {
+        destinations |= captures & ~occupied &
+                SQUARE_BIT(SQUARE(board->ep_col, board->ep_rank));
     }
-    return moves;
+    return destinations;
 }
 
-/* Generate a list of moves of a pawn from from_col,from_rank. */
+/* Generate a list of the legal moves of colour's piece on from.
+ * This does not include castling for the king, because it is used
+ * by the code that looks for ways to escape from check for which
+ * castling is illegal, of course.
+ * safety is that found for colour on board.
+ */
 static MovePair *
-generate_pawn_moves(Colour colour, const Board *board, Col from_col, Rank from_rank)
+generate_moves(Colour colour, Piece piece, unsigned from,
+        const KingSafety *safety, const Board *board)
 {
+    Col from_col = SQUARE_COL(from);
+    Rank from_rank = SQUARE_RANK(from);
     MovePair *moves = NULL;
-    Piece piece = PAWN;
-    Colour target_colour = OPPOSITE_COLOUR(colour);
-    /* Determine the direction in which a pawn can move. */
-    int offset = colour == WHITE ? 1 : -1;
-    int to_r, to_c = ColConvert(from_col);
+    Bitboard destinations;
 
-    /* Try single step ahead. */
-    to_r = RankConvert(from_rank) + offset;
-    if (board->board[to_r][to_c] == EMPTY) {
-        /* Fill in the details, and add it to the list. */
-        moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
-        if (((colour == WHITE) && (from_rank == FIRSTRANK + 1)) ||
-                ((colour == BLACK) && (from_rank == LASTRANK - 1))) {
-            /* Try two steps. */
-            to_r = RankConvert(from_rank) + 2 * offset;
-            if (board->board[to_r][to_c] == EMPTY) {
-                moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
-            }
-        }
-    }
-    /* Try to left. */
-    to_r = RankConvert(from_rank) + offset;
-    to_c = ColConvert(from_col) - 1;
-    if (board->board[to_r][to_c] == OFF) {
-    }
-    else if (board->board[to_r][to_c] == EMPTY) {
-        if (board->EnPassant && (ToRank(to_r) == board->ep_rank) &&
-                (ToCol(to_c) == board->ep_col)) {
-            moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
-        }
-    }
-    else if (EXTRACT_COLOUR(board->board[to_r][to_c]) == target_colour) {
-        moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
+    if (piece == PAWN) {
+        destinations = pawn_destinations(colour, from, board);
     }
     else {
-    }
+        Bitboard occupied = board->colour_squares[WHITE] | board->colour_squares[BLACK];
 
-    /* Try to right. */
-    to_r = RankConvert(from_rank) + offset;
-    to_c = ColConvert(from_col) + 1;
-    if (board->board[to_r][to_c] == OFF) {
-    }
-    else if (board->board[to_r][to_c] == EMPTY) {
-        if (board->EnPassant && (ToRank(to_r) == board->ep_rank) &&
-                (ToCol(to_c) == board->ep_col)) {
-            moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
-        }
-    }
-    else if (EXTRACT_COLOUR(board->board[to_r][to_c]) == target_colour) {
-        moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
-    }
-    else {
+        destinations = piece_attacks(piece, colour, from, occupied) &
+                ~board->colour_squares[colour];
     }
+    while (destinations != 0) {
+        unsigned to = first_square(destinations);
+        Col to_col = SQUARE_COL(to);
+        Rank to_rank = SQUARE_RANK(to);
 
-    if (moves != NULL) {
-        moves = exclude_checks(piece, colour, moves, board);
+        if (move_is_legal(piece, colour, from_col, from_rank, to_col, to_rank, safety, board)) {
+            moves = append_move_pair(from_col, from_rank, to_col, to_rank, moves);
+        }
+        destinations &= destinations - 1;
     }
     return moves;
 }
 
+/* Return the piece, without its colour, on the given square of board. */
+static Piece
+piece_on_square(unsigned square, const Board *board)
+{
+    return EXTRACT_PIECE(board->board[HEDGE + square / BOARDSIZE][HEDGE + square % BOARDSIZE]);
+}
+
 /* See whether the king of the given colour is in checkmate.
  * Assuming that the king is in check, generate all possible moves
  * for colour on board until at least one saving move is found.
@@ -2194,45 +2112,20 @@ generate_pawn_moves(Colour colour, const Board *board, Col from_col, Rank from_r
 Boolean
 king_is_in_checkmate(Colour colour, Board *board)
 {
-    Rank rank;
-    Col col;
+    Bitboard pieces = board->colour_squares[colour];
     MovePair *moves = NULL;
     Boolean in_checkmate = FALSE;
+    KingSafety safety;
 
-    /* Search the board for pieces of the right colour.
-     * Keep going until we have exhausted all pieces, or until
+    /* Keep going until we have exhausted all pieces, or until
      * we have found a saving move.
      */
-    for (rank = LASTRANK; (rank >= FIRSTRANK) && (moves == NULL); rank--) {
-        for (col = FIRSTCOL; (col <= LASTCOL) && (moves == NULL); col++) {
-            int r = RankConvert(rank);
-            int c = ColConvert(col);
-            Piece occupant = board->board[r][c];
-
-            if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
-                /* This square is occupied by a piece of the required colour. */
-                Piece piece = EXTRACT_PIECE(occupant);
-
-                switch (piece) {
-                    case KING:
-                    case KNIGHT:
-                        moves = generate_single_moves(colour, piece, board, col, rank);
-                        break;
-                    case QUEEN:
-                    case ROOK:
-                    case BISHOP:
-                        moves = generate_multiple_moves(colour, piece, board, col, rank);
-                        break;
-                    case PAWN:
-                        moves = generate_pawn_moves(colour, board, col, rank);
-                        break;
-                    default:
-                        fprintf(GlobalState.logfile,
-                                "Internal error: unknown piece %d in king_is_in_checkmate().\n",
-                                piece);
-                }
-            }
-        }
+    find_king_safety(board, colour, &safety);
+    while ((pieces != 0) && (moves == NULL)) {
+        unsigned from = first_square(pieces);
+
+        moves = generate_moves(colour, piece_on_square(from, board), from, &safety, board);
+        pieces &= pieces - 1;
     }
     if (moves != NULL) {
         /* No checkmate.  Free the move list. */
@@ -2255,55 +2148,27 @@ king_is_in_checkmate(Colour colour, Board *board)
 static unsigned
 approx_how_many_moves(Board *board)
 {
-    Rank rank;
-    Col col;
     Colour colour = board->to_move;
+    Bitboard pieces = board->colour_squares[colour];
     unsigned num_moves = 0;
+    KingSafety safety;
 
-    /* Search the board for pieces of the right colour.
-     * Keep going until we have exhausted all pieces, or until
-     * we have found a saving move.
-     */
-    for (rank = LASTRANK; rank >= FIRSTRANK; rank--) {
-        for (col = FIRSTCOL; col <= LASTCOL; col++) {
-            int r = RankConvert(rank);
-            int c = ColConvert(col);
-            Piece occupant = board->board[r][c];
-            MovePair *moves = NULL;
-
-            if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
-                /* This square is occupied by a piece of the required colour. */
-                Piece piece = EXTRACT_PIECE(occupant);
-
-                switch (piece) {
-                    case KING:
-                    case KNIGHT:
-                        moves = generate_single_moves(colour, piece, board, col, rank);
-                        break;
-                    case QUEEN:
-                    case ROOK:
-                    case BISHOP:
-                        moves = generate_multiple_moves(colour, piece, board, col, rank);
-                        break;
-                    case PAWN:
-                        moves = generate_pawn_moves(colour, board, col, rank);
-                        break;
-                    default:
-                        fprintf(GlobalState.logfile,
-                                "Internal error: unknown piece %d in king_is_in_checkmate().\n",
-                                piece);
-                }
-                if (moves != NULL) {
-                    /* At least one move. */
-                    MovePair *m;
-                    for (m = moves; m != NULL; m = m->next) {
-                        num_moves++;
-                    }
-                    /* Free the move list. */
-                    free_move_pair_list(moves);
-                }
+    find_king_safety(board, colour, &safety);
+    while (pieces != 0) {
+        unsigned from = first_square(pieces);
+        MovePair *moves = generate_moves(colour, piece_on_square(from, board), from,
+                &safety, board);
+
+        if (moves != NULL) {
+            /* At least one move. */
+            MovePair *m;
+            for (m = moves; m != NULL; m = m->next) {
+                num_moves++;
             }
+            /* Free the move list. */
+            free_move_pair_list(moves);
         }
+        pieces &= pieces - 1;
     }
     return num_moves;
 }
@@ -2313,82 +2178,46 @@ approx_how_many_moves(Board *board)
 MovePair *
 find_all_moves(const Board *board, Colour colour)
 {
-    Rank rank;
-    Col col;
+    Bitboard pieces = board->colour_squares[colour];
     /* All moves for colour. */
     MovePair *all_moves = NULL;
+    KingSafety safety;
 
     /* Pick up each piece of the required colour. */
-    for (rank = LASTRANK; rank >= FIRSTRANK; rank--) {
-        int r = RankConvert(rank);
-        for (col = FIRSTCOL; col <= LASTCOL; col++) {
-            int c = ColConvert(col);
-            Piece occupant = board->board[r][c];
-
-            if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
-                /* This square is occupied by a piece of the required colour. */
-                Piece piece = EXTRACT_PIECE(occupant);
-                /* List of moves for this piece. */
-                MovePair *moves = NULL;
-
-                switch (piece) {
-                    case KING:
-                        moves = generate_single_moves(colour, piece, board, col, rank);
-                        /* Add any castling, as this is not covered
-                         * by GenerateSingleMoves.
-                         */
-                        if (can_castle(KINGSIDE_CASTLE, colour, board)) {
-                            MovePair *m = (MovePair *)
-                                    malloc_or_die(sizeof (MovePair));
-                            m->from_col = find_castling_king_col(colour, board);
-                            m->from_rank = rank;
-                            m->to_col = 'g';
-                            m->to_rank = rank;
-                            /* Prepend. */
-                            m->next = moves;
-                            moves = m;
-                        }
-                        if (can_castle(QUEENSIDE_CASTLE, colour, board)) {
-                            MovePair *m = (MovePair *)
-                                    malloc_or_die(sizeof (MovePair));
-                            m->from_col = find_castling_king_col(colour, board);
-                            m->from_rank = rank;
-                            m->to_col = 'c';
-                            m->to_rank = rank;
-                            /* Prepend. */
-                            m->next = moves;
-                            moves = m;
-                        }
-                        break;
-                    case KNIGHT:
-                        moves = generate_single_moves(colour, piece, board, col, rank);
-                        break;
-                    case QUEEN:
-                    case ROOK:
-                    case BISHOP:
-                        moves = generate_multiple_moves(colour, piece, board, col, rank);
-                        break;
-                    case PAWN:
-                        moves = generate_pawn_moves(colour, board, col, rank);
-                        break;
-                    default:
-                        fprintf(GlobalState.logfile,
-                                "Internal error: unknown piece %d in king_is_in_checkmate().\n",
-                                piece);
-                }
-                if (moves != NULL) {
-                    /* At least one move.
-                     * Append what we have so far to this list.
-                     * Find the last one.
-                     */
-                    MovePair *m;
-                    for (m = moves; m->next != NULL; m = m->next) {
-                    }
-                    m->next = all_moves;
-                    all_moves = moves;
-                }
+    find_king_safety(board, colour, &safety);
+    while (pieces != 0) {
+        unsigned from = first_square(pieces);
+        Piece piece = piece_on_square(from, board);
+        /* List of moves for this piece. */
+        MovePair *moves = generate_moves(colour, piece, from, &safety, board);
+
+        if (piece == KING) {
+            Rank rank = SQUARE_RANK(from);
+
+            /* Add any castling, as this is not covered
+             * by generate_moves.
+             */
+            if (can_castle(KINGSIDE_CASTLE, colour, board)) {
+                moves = append_move_pair(find_castling_king_col(colour, board), rank,
+                        'g', rank, moves);
+            }
+            if (can_castle(QUEENSIDE_CASTLE, colour, board)) {
+                moves = append_move_pair(find_castling_king_col(colour, board), rank,
+                        'c', rank, moves);
             }
         }
+        if (moves != NULL) {
+            /* At least one move.
+             * Append what we have so far to this list.
+             * Find the last one.
+             */
+            MovePair *m;
+            for (m = moves; m->next != NULL; m = m->next) {
+            }
+            m->next = all_moves;
+            all_moves = moves;
+        }
+        pieces &= pieces - 1;
     }
     return all_moves;
 }
@@ -2397,67 +2226,49 @@ find_all_moves(const Board *board, Colour colour)
 Boolean
 at_least_one_move(const Board *board, Colour colour)
 {
+    Bitboard pieces = board->colour_squares[colour];
     Boolean move_found = FALSE;
+    KingSafety safety;
 
     /* Pick up each piece of the required colour. */
-    for (Rank rank = LASTRANK; rank >= FIRSTRANK && !move_found; rank--) {
-        int r = RankConvert(rank);
-        for (Col col = FIRSTCOL; col <= LASTCOL && !move_found; col++) {
-            Piece occupant = board->board[r][ColConvert(col)];
-
-            if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
-                /* This square is occupied by a piece of the required colour. */
-                Piece piece = EXTRACT_PIECE(occupant);
-                MovePair *moves = NULL;
-
-                switch (piece) {
-                    case KING:
-                        moves = generate_single_moves(colour, piece, board, col, rank);
-                        if (moves != NULL) {
-                            move_found = TRUE;
-                            free_move_pair_list(moves);
-                        }
-                            /* Add any castling, as this is not covered
-                             * by GenerateSingleMoves.
-                             */
-                        else if (can_castle(KINGSIDE_CASTLE, colour, board)) {
-                            move_found = TRUE;
-                        }
-                        else if (can_castle(QUEENSIDE_CASTLE, colour, board)) {
-                            move_found = TRUE;
-                        }
-                        break;
-                    case KNIGHT:
-                        moves = generate_single_moves(colour, piece, board, col, rank);
-                        if (moves != NULL) {
-                            move_found = TRUE;
-                            free_move_pair_list(moves);
-                        }
-                        break;
-                    case QUEEN:
-                    case ROOK:
-                    case BISHOP:
-                        moves = generate_multiple_moves(colour, piece, board, col, rank);
-                        if (moves != NULL) {
-                            move_found = TRUE;
-                            free_move_pair_list(moves);
-                        }
-                        break;
-                    case PAWN:
-                        moves = generate_pawn_moves(colour, board, col, rank);
-                        if (moves != NULL) {
-                            move_found = TRUE;
-                            free_move_pair_list(moves);
-                        }
-                        break;
-                    default:
-                        fprintf(GlobalState.logfile,
-                                "Internal error: unknown piece %d in king_is_in_checkmate().\n",
-                                piece);
-                }
-            }
+    find_king_safety(board, colour, &safety);
+    while (pieces != 0 && !move_found) {
+        unsigned from = first_square(pieces);
+        Piece piece = piece_on_square(from, board);
+        MovePair *moves = generate_moves(colour, piece, from, &safety, board);
+
+        if (moves != NULL) {
+            move_found = TRUE;
+            free_move_pair_list(moves);
+        }
+        /* Add any castling, as this is not covered
+         * by generate_moves.
+         */
+        else if (piece == KING) {
+            move_found = can_castle(KINGSIDE_CASTLE, colour, board) ||
+                    can_castle(QUEENSIDE_CASTLE, colour, board);
         }
+        pieces &= pieces - 1;
     }
     return move_found;
 }
 
+/* Return TRUE if colour has exactly one legal move on the given board.
+ * A pawn move to the last rank counts as one move for each promotion.
+ */
+Boolean
+only_one_move(const Board *board, Colour colour)
+{
+    MovePair *moves = find_all_moves(board, colour);
+    Boolean only_one = FALSE;
+
+    if (moves != NULL && moves->next == NULL) {
+        Piece occupant = board->board[RankConvert(moves->from_rank)][ColConvert(moves->from_col)];
+
+        only_one = EXTRACT_PIECE(occupant) != PAWN ||
+                (moves->to_rank != FIRSTRANK && moves->to_rank != LASTRANK);
+    }
+    free_move_pair_list(moves);
+    return only_one;
+}
+
@@ -43,6 +43,7 @@ Col find_castling_king_col(Colour colour, const Board *board);
 Col find_castling_rook_col(Colour colour, const Board *board, MoveClass castling);
 MovePair *find_all_moves(const Board *board, Colour colour);
 Boolean at_least_one_move(const Board *board, Colour colour);
+Boolean only_one_move(const Board *board, Colour colour);
 
 #endif	// MAP_H
 
@@ -317,9 +317,7 @@ compose_positional_variation(char *line)
         }
     }
     else {
-        if (head != NULL) {
-            free_move_list(head);
-        }
+        /* The moves are freed with those of the first game. */
         head = NULL;
     }
     return head;
@@ -348,7 +346,6 @@ add_positional_variation_from_line(char *line)
              * the initial position.
              */
             store_hash_value(next_variation, (const char *) NULL);
-            free_move_list(next_variation);
             /* We need to know globally that positional variations
              * are of interest.
              */
@@ -34,6 +34,7 @@
 #include "apply.h"
 #include "output.h"
 #include "mymalloc.h"
+#include "arena.h"
 
 
 /* Functions for outputting games in the required format. */
@@ -48,9 +49,6 @@
 /* Define a macro to calculate an array's size. */
 #define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(*arr))
 
-/* A small size for formatted move numbers. */
-#define FORMATTED_NUMBER_SIZE (20)
-
 /* How much text we have output on the current line. */
 static size_t line_length = 0;
 /* The buffer in which each output line of a game is built. */
@@ -237,7 +235,8 @@ select_tag_string(TagName tag)
     if ((tag == PSEUDO_PLAYER_TAG) || 
             (tag == PSEUDO_ELO_TAG) || 
             (tag == PSEUDO_FEN_PATTERN_TAG) ||
-            (tag == PSEUDO_FEN_PATTERN_I_TAG)) {
+            (tag == PSEUDO_FEN_PATTERN_I_TAG) ||
+            (tag == BOOK_DEPTH_TAG && GlobalState.drop_book_depth_tag)) {
         tag_string = NULL;
     }
     else {
@@ -972,6 +971,24 @@ print_items_following_move(FILE *outputfile, const Move *move_details,
             something_printed = TRUE;
         }
     }
+    if (GlobalState.add_forced_comments && move_details->forced) {
+        if(GlobalState.json_format) {
+            fprintf(outputfile, ", \"Forced\" : true");
+        }
+        else {
+            print_as_comment(outputfile, "forced");
+            something_printed = TRUE;
+        }
+    }
+    if (GlobalState.add_book_comments && move_details->book) {
+        if(GlobalState.json_format) {
+            fprintf(outputfile, ", \"Book\" : true");
+        }
+        else {
+            print_as_comment(outputfile, "book");
+            something_printed = TRUE;
+        }
+    }
     if (variants != NULL) {
         if(GlobalState.keep_variations) {
             if(!GlobalState.split_variants) {
@@ -1679,7 +1696,7 @@ static CommentList *create_line_number_comment(const Game *game)
 {
     unsigned numbytes = strlen(GlobalState.line_number_marker) + 1 +
         lineNumberChars(game->start_line) + 1 + lineNumberChars(game->end_line) + 1;
-    char *line_number_comment = (char *) malloc_or_die(numbytes);
+    char *line_number_comment = (char *) game_malloc(numbytes);
     sprintf(line_number_comment, "%s:%lu:%lu",
     		GlobalState.line_number_marker,
 		game->start_line,
@@ -1689,7 +1706,7 @@ static CommentList *create_line_number_comment(const Game *game)
 	exit(1);
     }
     StringList *current_comment = save_string_list_item(NULL, line_number_comment);
-    CommentList *comment = (CommentList*) malloc_or_die(sizeof (*comment));
+    CommentList *comment = (CommentList*) game_malloc(sizeof (*comment));
 
     comment->comment = current_comment;
     comment->next = NULL;
@@ -0,0 +1,416 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/*
+ * With --jobs N, each input file is divided into as many as N parts
+ * at the start of a game, and each part is parsed, checked and output
+ * by a worker process of its own. The lexical analyser, the board and
+ * GlobalState are all global, so the workers are processes rather than
+ * threads: each has its own copy of them, set up by the arguments and
+ * the ECO file before it is created. A worker writes its games to a
+ * temporary file, and its messages to another, which are copied to the
+ * output and the log once the worker has finished, in the order of the
+ * parts, so they are the same as parsing the file serially. The workers
+ * do not report their progress; the parent does after each part.
+ * The parts are independent only when no decision about a game depends
+ * on the games before it, so options such as duplicate detection and
+ * --stopafter leave the input to be parsed serially.
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#define PARALLEL_PARSING
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "bool.h"
+#include "mymalloc.h"
+#include "defs.h"
+#include "typedef.h"
+#include "tokens.h"
+#include "taglist.h"
+#include "lex.h"
+#include "grammar.h"
+#include "parallel.h"
+
+#ifdef PARALLEL_PARSING
+
+/* A file is not divided into parts smaller than this. */
+#define MIN_PART_SIZE (1 << 20)
+/* The output of a part is copied in blocks of this size. */
+#define COPY_BLOCK_SIZE (1 << 16)
+
+/* One part of an input file, parsed by a worker process. */
+typedef struct {
+    /* Where the part lies in the file. */
+    size_t start;
+    size_t length;
+    /* The number of lines of the file before the part. */
+    unsigned long first_line;
+    /* The temporary file of the games output by the worker. */
+    FILE *output;
+    /* The temporary file of the worker's messages. */
+    FILE *log;
+    /* Where the worker reports the number of games processed and matched. */
+    int counts_fd;
+    pid_t worker;
+} FilePart;
+
+/* Whether each game may be parsed and output without knowledge of
+ * the games before it.
+ */
+static Boolean
+games_are_independent(void)
+{
+    unsigned file_number;
+
+    if (input_file_name(0) == NULL) {
+        /* stdin cannot be divided. */
+        return FALSE;
+    }
+    for (file_number = 0; input_file_name(file_number) != NULL; file_number++) {
+        if (input_file_type(file_number) != NORMALFILE) {
+            return FALSE;
+        }
+    }
+    return !GlobalState.suppress_duplicates &&
+            !GlobalState.suppress_originals &&
+            !GlobalState.fuzzy_match_duplicates &&
+            !GlobalState.use_virtual_hash_table &&
+            GlobalState.duplicate_file == NULL &&
+            GlobalState.non_matching_file == NULL &&
+            !GlobalState.json_format &&
+            GlobalState.games_per_file == 0 &&
+            GlobalState.ECO_level == DONT_DIVIDE &&
+            GlobalState.maximum_matches == 0 &&
+            GlobalState.matching_game_numbers == NULL &&
+            GlobalState.skip_game_numbers == NULL;
+}
+
+/* Return the offset of the first game in data[from..size) that starts
+ * with a tag on the line after a blank line, or size if there is none.
+ * A comment holding such a line would be mistaken for the start of
+ * a game, but that is most unlikely in practice.
+ */
+static size_t
+next_game_start(const char *data, size_t size, size_t from)
+{
+    const char *end = data + size;
+    const char *p = data + from;
+
+    while ((p = (const char *) memchr(p, '[', end - p)) != NULL) {
+        size_t at = p - data;
+
+        if (at >= 2 && at + 1 < size && data[at - 1] == '\n' &&
+                isalpha((unsigned char) data[at + 1])) {
+            if (data[at - 2] == '\n' ||
+                    (at >= 3 && data[at - 2] == '\r' && data[at - 3] == '\n')) {
+                return at;
+            }
+        }
+        p++;
+    }
+    return size;
+}
+
+/* Return the number of lines ending in data[0..length). */
+static unsigned long
+count_lines(const char *data, size_t length)
+{
+    const char *end = data + length;
+    const char *p = data;
+    unsigned long lines = 0;
+
+    while ((p = (const char *) memchr(p, '\n', end - p)) != NULL) {
+        lines++;
+        p++;
+    }
+    return lines;
+}
+
+/* Divide the size bytes of data into at most max_parts parts of
+ * roughly equal size. Return the number of parts.
+ */
+static unsigned
+divide_file(const char *data, size_t size, FilePart *parts, unsigned max_parts)
+{
+    const size_t part_size = size / max_parts;
+    unsigned num_parts = 0;
+    unsigned long lines = 0;
+    size_t start = 0;
+
+    while (start < size) {
+        size_t end;
+
+        if (num_parts == max_parts - 1) {
+            end = size;
+        }
+        else {
+            size_t from = part_size * (num_parts + 1);
+
+            end = next_game_start(data, size, from > start ? from : start + 1);
+        }
+        parts[num_parts].start = start;
+        parts[num_parts].length = end - start;
+        parts[num_parts].first_line = lines;
+        lines += count_lines(data + start, end - start);
+        num_parts++;
+        start = end;
+    }
+    return num_parts;
+}
+
+/* Parse the given part of a file in a worker process, which then exits.
+ * The part is the whole of the file open as fd if data is NULL.
+ */
+static void
+parse_part(const char *filename, int fd, const char *data,
+        const FilePart *part, int counts_fd)
+{
+    const unsigned long processed = GlobalState.num_games_processed;
+    const unsigned long matched = GlobalState.num_games_matched;
+    unsigned long counts[2];
+    FILE *fp;
+
+    if (data != NULL) {
+        fp = fmemopen((void *) (data + part->start), part->length, "r");
+    }
+    else {
+        fp = fdopen(fd, "rb");
+    }
+    GlobalState.logfile = part->log;
+    set_progress_rate(0);
+    if (fp == NULL || !open_input_part(fp, filename, part->first_line)) {
+        fprintf(GlobalState.logfile, "Unable to read the PGN file: %s\n", filename);
+        (void) fflush(NULL);
+        _exit(1);
+    }
+    GlobalState.outputfile = part->output;
+    yyparse(NORMALFILE);
+
+    counts[0] = GlobalState.num_games_processed - processed;
+    counts[1] = GlobalState.num_games_matched - matched;
+    (void) fflush(NULL);
+    if (write(counts_fd, counts, sizeof(counts)) != (ssize_t) sizeof(counts)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+/* Create the worker process for the given part. */
+static void
+start_worker(const char *filename, int fd, const char *data, FilePart *part)
+{
+    int counts_pipe[2];
+
+    part->output = tmpfile();
+    part->log = tmpfile();
+    if (part->output == NULL || part->log == NULL || pipe(counts_pipe) != 0) {
+        perror("pgn-extract");
+        exit(1);
+    }
+    part->worker = fork();
+    if (part->worker < 0) {
+        perror("pgn-extract");
+        exit(1);
+    }
+    else if (part->worker == 0) {
+        (void) close(counts_pipe[0]);
+        parse_part(filename, fd, data, part, counts_pipe[1]);
+    }
+    else {
+        (void) close(counts_pipe[1]);
+        part->counts_fd = counts_pipe[0];
+    }
+}
+
+/* Copy the contents of the temporary file from to the end of to,
+ * and close from.
+ */
+static void
+copy_temporary_file(FILE *from, FILE *to)
+{
+    char *block = (char *) malloc_or_die(COPY_BLOCK_SIZE);
+    size_t bytes;
+
+    rewind(from);
+    while ((bytes = fread(block, 1, COPY_BLOCK_SIZE, from)) > 0) {
+        (void) fwrite(block, 1, bytes, to);
+    }
+    (void) free((void *) block);
+    (void) fclose(from);
+}
+
+/* Wait for the worker of the given part, and copy its messages to
+ * the log and its games to the output. Return FALSE if it failed.
+ */
+static Boolean
+finish_part(const char *filename, FilePart *part)
+{
+    unsigned long counts[2];
+    Boolean ok;
+    int status;
+
+    ok = read(part->counts_fd, counts, sizeof(counts)) == (ssize_t) sizeof(counts);
+    (void) close(part->counts_fd);
+    if (waitpid(part->worker, &status, 0) != part->worker ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        ok = FALSE;
+    }
+
+    copy_temporary_file(part->log, GlobalState.logfile);
+    if (ok) {
+        GlobalState.num_games_processed += counts[0];
+        GlobalState.num_games_matched += counts[1];
+        copy_temporary_file(part->output, GlobalState.outputfile);
+        if (GlobalState.verbosity != 0) {
+            fprintf(stderr, "Games: %lu\r", GlobalState.num_games_processed);
+        }
+    }
+    else {
+        (void) fclose(part->output);
+        fprintf(GlobalState.logfile, "A worker failed to parse part of %s\n",
+                filename);
+    }
+    return ok;
+}
+
+/* Parse the given file in as many as GlobalState.jobs parts.
+ * Return FALSE if it could not be opened or parsed.
+ */
+static Boolean
+parse_file(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    const char *data = NULL;
+    size_t size = 0;
+    unsigned num_parts = 1;
+    FilePart *parts;
+    Boolean ok = TRUE;
+    unsigned part;
+
+    if (fd < 0) {
+        fprintf(GlobalState.logfile, "Unable to open the PGN file: %s\n", filename);
+        return FALSE;
+    }
+    GlobalState.current_input_file = filename;
+    if (GlobalState.verbosity > 1) {
+        fprintf(GlobalState.logfile, "Processing %s\n", filename);
+    }
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+            info.st_size / MIN_PART_SIZE > 1) {
+        size = (size_t) info.st_size;
+        num_parts = size / MIN_PART_SIZE;
+        if (num_parts > GlobalState.jobs) {
+            num_parts = GlobalState.jobs;
+        }
+        data = (const char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == (const char *) MAP_FAILED) {
+            data = NULL;
+            num_parts = 1;
+        }
+    }
+
+    parts = (FilePart *) malloc_or_die(num_parts * sizeof(*parts));
+    if (data != NULL) {
+        num_parts = divide_file(data, size, parts, num_parts);
+    }
+    else {
+        parts[0].start = 0;
+        parts[0].length = 0;
+        parts[0].first_line = 0;
+    }
+
+    /* Nothing buffered may be written twice, by a worker as well. */
+    (void) fflush(NULL);
+    for (part = 0; part < num_parts; part++) {
+        start_worker(filename, fd, data, &parts[part]);
+    }
+    for (part = 0; part < num_parts; part++) {
+        if (!finish_part(filename, &parts[part])) {
+            ok = FALSE;
+        }
+    }
+
+    (void) free((void *) parts);
+    if (data != NULL) {
+        (void) munmap((void *) data, size);
+    }
+    (void) close(fd);
+    return ok;
+}
+
+/* Parse all of the input files with worker processes, if --jobs asks for
+ * more than one and the games may be parsed independently.
+ * Return FALSE, having parsed nothing, if the input is to be parsed serially.
+ */
+Boolean
+parse_in_parallel(void)
+{
+    unsigned file_number;
+
+    if (GlobalState.jobs <= 1) {
+        return FALSE;
+    }
+    else if (!games_are_independent()) {
+        fprintf(GlobalState.logfile,
+                "--jobs is ignored for stdin, check files, duplicates, JSON, "
+                "-#, -E, -n, --selectonly, --skipmatching and --stopafter.\n");
+        return FALSE;
+    }
+    else {
+        for (file_number = 0; input_file_name(file_number) != NULL; file_number++) {
+            if (!parse_file(input_file_name(file_number))) {
+                if (file_number == 0) {
+                    exit(1);
+                }
+                /* As with serial parsing, stop at a file that fails. */
+                break;
+            }
+        }
+        return TRUE;
+    }
+}
+
+#else
+
+Boolean
+parse_in_parallel(void)
+{
+    if (GlobalState.jobs > 1) {
+        fprintf(GlobalState.logfile, "--jobs is not available on this platform.\n");
+    }
+    return FALSE;
+}
+
+#endif
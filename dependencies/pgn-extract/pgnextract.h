@@ -0,0 +1,88 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+        /* Entry points for using pgn-extract as a linked library
+         * (libpgnextract.a) rather than as a separate program.
+         * The library shares pgn-extract's global state, so only
+         * one conversion may be in progress at a time.
+         */
+#ifndef PGNEXTRACT_H
+#define PGNEXTRACT_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Prepare the global tables. Must be called once before
+ * the first conversion.
+ */
+void pgn_extract_init(void);
+/* Flags for the options argument of pgn_extract_convert. */
+/* Add the hash code of the position after each move as a comment (--hashcomments). */
+#define PGN_EXTRACT_HASH_COMMENTS 0x1
+/* Add the FEN of the position after each move as a comment (--fencomments). */
+#define PGN_EXTRACT_FEN_COMMENTS 0x2
+/* Add a "forced" comment after each move that leaves the other side
+ * only one legal move (--forcedcomments).
+ */
+#define PGN_EXTRACT_FORCED_COMMENTS 0x4
+/* Add a BookDepth tag of the plies of each game that follow the
+ * lines of the ECO file read by pgn_extract_load_eco (--addbookdepth).
+ */
+#define PGN_EXTRACT_BOOK_DEPTH 0x8
+/* Add a "book" comment after each move that is one of the moves of
+ * the Polyglot book opened by pgn_extract_load_book (--polyglotbook).
+ */
+#define PGN_EXTRACT_BOOK_COMMENTS 0x10
+/* Leave the BookDepth tag out of the games written, for output
+ * that has been through a pass with PGN_EXTRACT_BOOK_DEPTH.
+ */
+#define PGN_EXTRACT_NO_BOOK_DEPTH 0x20
+
+/* Read the ECO lines of eco_file for PGN_EXTRACT_BOOK_DEPTH.
+ * Must be called once, after pgn_extract_init.
+ * Return 0 if the file cannot be opened.
+ */
+int pgn_extract_load_eco(const char *eco_file);
+
+/* Open the Polyglot opening book book_file for PGN_EXTRACT_BOOK_COMMENTS.
+ * Must be called after pgn_extract_init.
+ * Return 0 if the file cannot be read as a book.
+ */
+int pgn_extract_load_book(const char *book_file);
+
+/* Parse the games on infp and write them to outfp using the
+ * given -W output format, e.g. "uci" or "sanPNBRQK".
+ * options is zero or more of the PGN_EXTRACT_ flags.
+ * input_name is only used in error reports.
+ * Return the number of games written.
+ */
+unsigned long pgn_extract_convert(FILE *infp, const char *input_name,
+                                  FILE *outfp, const char *format,
+                                  unsigned options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// PGNEXTRACT_H
@@ -0,0 +1,238 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/*
+ * A Polyglot book is a file of 16-byte entries, sorted by key:
+ * an 8-byte position key, a 2-byte move, a 2-byte weight and a
+ * 4-byte learn value, all of them big-endian.
+ * See http://hardy.uhasselt.be/Toga/book_format.html
+ * The file is mapped into memory where the platform allows it,
+ * and otherwise read into it, and then searched in place.
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MAP_POLYGLOT_BOOK
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bool.h"
+#include "defs.h"
+#include "typedef.h"
+#include "mymalloc.h"
+#include "polyglot.h"
+
+#define BOOK_ENTRY_SIZE 16
+
+/* The entries of the open book. */
+static const unsigned char *book_entries = NULL;
+static size_t num_book_entries = 0;
+/* Whether book_entries is mapped rather than allocated. */
+static Boolean book_mapped = FALSE;
+
+static void
+close_polyglot_book(void)
+{
+    if (book_entries != NULL) {
+#ifdef MAP_POLYGLOT_BOOK
+        if (book_mapped) {
+            (void) munmap((void *) book_entries,
+                          num_book_entries * BOOK_ENTRY_SIZE);
+        }
+        else {
+            (void) free((void *) book_entries);
+        }
+#else
+        (void) free((void *) book_entries);
+#endif
+    }
+    book_entries = NULL;
+    num_book_entries = 0;
+    book_mapped = FALSE;
+}
+
+/* Open filename as the book used by polyglot_book_move,
+ * in place of any that was open before.
+ * Return FALSE if it cannot be read or is not a Polyglot book.
+ */
+Boolean
+open_polyglot_book(const char *filename)
+{
+    size_t size = 0;
+    Boolean Ok = FALSE;
+
+    close_polyglot_book();
+#ifdef MAP_POLYGLOT_BOOK
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        struct stat details;
+        if (fstat(fd, &details) == 0) {
+            size = (size_t) details.st_size;
+            if (size == 0) {
+                /* An empty book; there is nothing to map. */
+                Ok = TRUE;
+            }
+            else if (size % BOOK_ENTRY_SIZE == 0) {
+                void *entries = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (entries != MAP_FAILED) {
+                    book_entries = (const unsigned char *) entries;
+                    book_mapped = TRUE;
+                    Ok = TRUE;
+                }
+            }
+        }
+        (void) close(fd);
+    }
+#else
+    FILE *fp = fopen(filename, "rb");
+    if (fp != NULL) {
+        if (fseek(fp, 0L, SEEK_END) == 0) {
+            long length = ftell(fp);
+            if (length >= 0 && length % BOOK_ENTRY_SIZE == 0) {
+                size = (size_t) length;
+                rewind(fp);
+                if (size == 0) {
+                    Ok = TRUE;
+                }
+                else {
+                    unsigned char *entries = (unsigned char *) malloc_or_die(size);
+                    if (fread(entries, 1, size, fp) == size) {
+                        book_entries = entries;
+                        Ok = TRUE;
+                    }
+                    else {
+                        (void) free((void *) entries);
+                    }
+                }
+            }
+        }
+        (void) fclose(fp);
+    }
+#endif
+    if (Ok) {
+        num_book_entries = size / BOOK_ENTRY_SIZE;
+    }
+    else {
+        fprintf(GlobalState.logfile,
+                "Unable to read %s as a Polyglot book.\n", filename);
+    }
+    return Ok;
+}
+
+static uint64_t
+entry_key(size_t index)
+{
+    const unsigned char *entry = book_entries + index * BOOK_ENTRY_SIZE;
+    uint64_t key = 0;
+    for (int i = 0; i < 8; i++) {
+        key = (key << 8) | entry[i];
+    }
+    return key;
+}
+
+static unsigned
+entry_short(size_t index, int offset)
+{
+    const unsigned char *entry = book_entries + index * BOOK_ENTRY_SIZE + offset;
+    return (entry[0] << 8) | entry[1];
+}
+
+/* The Polyglot encoding of a move:
+ * the to square in bits 0-5, the from square in bits 6-11 and
+ * any promotion in bits 12-14. Castling is written as the king
+ * taking its own rook, e.g. e1h1 for White's O-O.
+ */
+static unsigned
+polyglot_move(const Move *move_details)
+{
+    unsigned to_col = move_details->to_col - FIRSTCOL;
+    unsigned promotion = 0;
+
+    switch (move_details->class) {
+        case KINGSIDE_CASTLE:
+            to_col = LASTCOL - FIRSTCOL;
+            break;
+        case QUEENSIDE_CASTLE:
+            to_col = 0;
+            break;
+        case PAWN_MOVE_WITH_PROMOTION:
+            switch (move_details->promoted_piece) {
+                case KNIGHT:
+                    promotion = 1;
+                    break;
+                case BISHOP:
+                    promotion = 2;
+                    break;
+                case ROOK:
+                    promotion = 3;
+                    break;
+                case QUEEN:
+                    promotion = 4;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+    return (promotion << 12) |
+           ((unsigned) (move_details->from_rank - FIRSTRANK) << 9) |
+           ((unsigned) (move_details->from_col - FIRSTCOL) << 6) |
+           ((unsigned) (move_details->to_rank - FIRSTRANK) << 3) |
+           to_col;
+}
+
+/* Is move_details, played from the position with the Polyglot
+ * key of key, one of the moves of the open book?
+ * Moves the book gives a weight of zero are never to be played
+ * from it, so they do not count.
+ */
+Boolean
+polyglot_book_move(uint64_t key, const Move *move_details)
+{
+    size_t low = 0, high = num_book_entries;
+    unsigned move;
+
+    /* Find the first entry for key. */
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entry_key(mid) < key) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    move = polyglot_move(move_details);
+    for (; low < num_book_entries && entry_key(low) == key; low++) {
+        if (entry_short(low, 8) == move && entry_short(low, 10) > 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
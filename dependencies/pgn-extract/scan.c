@@ -0,0 +1,219 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2021 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/*
+ * The scans look at 16 bytes at a time with SSE2, or 32 with AVX2,
+ * when the processor has them, and otherwise at one byte at a time.
+ * The choice is made once, by init_scanning.
+ * The loads are aligned to their size, so although they may read
+ * beyond the '\0' at the end of the input, they never cross into
+ * the next page of memory.
+ */
+
+#include <stdint.h>
+#include "bool.h"
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/* The white space characters, as classified by ChTab in lex.c. */
+#define IS_WHITE_SPACE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\r')
+
+/* Return the first character at or after p that is a, b or c. */
+static const unsigned char *
+find_any_scalar(const unsigned char *p,
+                unsigned char a, unsigned char b, unsigned char c)
+{
+    while (*p != a && *p != b && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+/* Return the first character at or after p that is not white space. */
+static const unsigned char *
+find_non_space_scalar(const unsigned char *p)
+{
+    while (IS_WHITE_SPACE(*p)) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static const unsigned char *
+find_any_sse2(const unsigned char *p,
+              unsigned char a, unsigned char b, unsigned char c)
+{
+    unsigned misalign = (unsigned) ((uintptr_t) p & 15);
+    const __m128i *block = (const __m128i *) (p - misalign);
+    const __m128i va = _mm_set1_epi8((char) a);
+    const __m128i vb = _mm_set1_epi8((char) b);
+    const __m128i vc = _mm_set1_epi8((char) c);
+    /* Ignore the bytes of the first block before p. */
+    unsigned mask = 0xffffu << misalign;
+
+    while (TRUE) {
+        __m128i v = _mm_load_si128(block);
+        __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va),
+                                                  _mm_cmpeq_epi8(v, vb)),
+                                     _mm_cmpeq_epi8(v, vc));
+        unsigned bits = (unsigned) _mm_movemask_epi8(found) & mask;
+        if (bits != 0) {
+            return (const unsigned char *) block + __builtin_ctz(bits);
+        }
+        mask = 0xffffu;
+        block++;
+    }
+}
+
+__attribute__((target("sse2")))
+static const unsigned char *
+find_non_space_sse2(const unsigned char *p)
+{
+    unsigned misalign = (unsigned) ((uintptr_t) p & 15);
+    const __m128i *block = (const __m128i *) (p - misalign);
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    unsigned mask = 0xffffu << misalign;
+
+    while (TRUE) {
+        __m128i v = _mm_load_si128(block);
+        __m128i white = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                                  _mm_cmpeq_epi8(v, tab)),
+                                     _mm_cmpeq_epi8(v, cr));
+        /* The '\0' at the end is not white space, so this stops there. */
+        unsigned bits = ~(unsigned) _mm_movemask_epi8(white) & mask;
+        if (bits != 0) {
+            return (const unsigned char *) block + __builtin_ctz(bits);
+        }
+        mask = 0xffffu;
+        block++;
+    }
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+find_any_avx2(const unsigned char *p,
+              unsigned char a, unsigned char b, unsigned char c)
+{
+    unsigned misalign = (unsigned) ((uintptr_t) p & 31);
+    const __m256i *block = (const __m256i *) (p - misalign);
+    const __m256i va = _mm256_set1_epi8((char) a);
+    const __m256i vb = _mm256_set1_epi8((char) b);
+    const __m256i vc = _mm256_set1_epi8((char) c);
+    uint32_t mask = 0xffffffffu << misalign;
+
+    while (TRUE) {
+        __m256i v = _mm256_load_si256(block);
+        __m256i found = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va),
+                                                        _mm256_cmpeq_epi8(v, vb)),
+                                        _mm256_cmpeq_epi8(v, vc));
+        uint32_t bits = (uint32_t) _mm256_movemask_epi8(found) & mask;
+        if (bits != 0) {
+            return (const unsigned char *) block + __builtin_ctz(bits);
+        }
+        mask = 0xffffffffu;
+        block++;
+    }
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+find_non_space_avx2(const unsigned char *p)
+{
+    unsigned misalign = (unsigned) ((uintptr_t) p & 31);
+    const __m256i *block = (const __m256i *) (p - misalign);
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    uint32_t mask = 0xffffffffu << misalign;
+
+    while (TRUE) {
+        __m256i v = _mm256_load_si256(block);
+        __m256i white = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                                        _mm256_cmpeq_epi8(v, tab)),
+                                        _mm256_cmpeq_epi8(v, cr));
+        uint32_t bits = ~(uint32_t) _mm256_movemask_epi8(white) & mask;
+        if (bits != 0) {
+            return (const unsigned char *) block + __builtin_ctz(bits);
+        }
+        mask = 0xffffffffu;
+        block++;
+    }
+}
+#endif
+
+static const unsigned char *(*find_any)(const unsigned char *p,
+        unsigned char a, unsigned char b, unsigned char c) = find_any_scalar;
+static const unsigned char *(*find_non_space)(const unsigned char *p) =
+        find_non_space_scalar;
+
+/* Choose the widest scans the processor supports. */
+void
+init_scanning(void)
+{
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        find_any = find_any_avx2;
+        find_non_space = find_non_space_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        find_any = find_any_sse2;
+        find_non_space = find_non_space_sse2;
+    }
+#endif
+}
+
+/* Return the first character at or after p that could end
+ * or nest a comment: '{', '}' or the '\0' at the end of the line.
+ */
+const unsigned char *
+scan_comment(const unsigned char *p)
+{
+    return find_any(p, '{', '}', '\0');
+}
+
+/* Return the first character at or after p that could end
+ * a string or escape the next one: '"', '\\' or '\0'.
+ */
+const unsigned char *
+scan_string(const unsigned char *p)
+{
+    return find_any(p, '"', '\\', '\0');
+}
+
+/* Return the first character at or after p that is not white space. */
+const unsigned char *
+skip_white_space(const unsigned char *p)
+{
+    /* Most runs of white space are a single character. */
+    if (!IS_WHITE_SPACE(*p)) {
+        return p;
+    }
+    return find_non_space(p + 1);
+}
@@ -59,6 +59,7 @@ read_tag_file(const char *TagFile)
                 keep_reading = FALSE;
             }
         }
+        close_input_lines();
         (void) fclose(yyin);
         /* Call yywrap in order to set up for the next (first) input file. */
         (void) yywrap();
@@ -89,6 +90,7 @@ read_tag_roster_file(const char *RosterFile)
             keep_reading = FALSE;
         }
     }
+    close_input_lines();
     (void) fclose(yyin);
     /* Call yywrap in order to set up for the next (first) input file. */
     (void) yywrap();
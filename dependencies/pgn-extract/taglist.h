@@ -41,6 +41,11 @@ typedef enum {
     BLACK_TYPE_TAG,
     BLACK_USCF_TAG,
     BOARD_TAG,
+    /* The BOOK_DEPTH_TAG is not a real PGN one.  It is used with the
+     * --addbookdepth argument to record how many plies of the game
+     * follow the lines of the ECO file.
+     */
+    BOOK_DEPTH_TAG,
     DATE_TAG,
     ECO_TAG,
     /* The PSEUDO_ELO_TAG is not a real PGN one.  It is used with the -t
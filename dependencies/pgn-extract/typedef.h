@@ -123,6 +123,16 @@ typedef struct move {
      * Only set if GlobalState.add_hashcode_comments. 
      */
     uint64_t zobrist;
+    /* Whether the side to move has only one legal move in the position
+     * after this move has been played.
+     * Only set if GlobalState.add_forced_comments.
+     */
+    Boolean forced;
+    /* Whether this move is one of the book's moves for the position
+     * before it (see polyglot.c).
+     * Only set if GlobalState.add_book_comments.
+     */
+    Boolean book;
     /* Evaluation of the position after this move has been played.
      * This is primarily a hook for anyone wanting to build a proper
      * evaluation function (see apply.c) or interface to an external
@@ -260,6 +270,10 @@ typedef struct {
     Boolean add_ECO;
     /* Whether an ECO file is currently being parsed. */
     Boolean parsing_ECO_file;
+    /* Whether to add a BookDepth tag from the ECO lines. */
+    Boolean add_book_depth_tag;
+    /* Whether to leave the BookDepth tag out of the output. */
+    Boolean drop_book_depth_tag;
     
     /* Which level to divide the output. */
     EcoDivision ECO_level;
@@ -329,6 +343,8 @@ typedef struct {
     int drop_ply_number;
     /* Starting ply for looking for matches. */
     unsigned startply;
+    /* Number of worker processes sharing the parsing of each file. */
+    unsigned jobs;
     
     /* Whether to output a FEN string. Either at the end of the game
      * or replacing a matching comment (see FEN_comment_pattern). */
@@ -337,6 +353,10 @@ typedef struct {
     Boolean add_FEN_comments;
     /* Whether to add a hashcode comment after every move. */
     Boolean add_hashcode_comments;
+    /* Whether to add a comment after every move that leaves only one reply. */
+    Boolean add_forced_comments;
+    /* Whether to add a comment after every move of the Polyglot book. */
+    Boolean add_book_comments;
     /* Whether to add a 'matching position' comment. */
     Boolean add_position_match_comments;
     /* Whether to include a PlyCount tag. */
@@ -19,20 +19,29 @@
  *  https://www.cs.kent.ac.uk/people/staff/djb/
  */
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "string.h"
 #include "engine.h"
 #include "evaluation.h"
+#include "evalcache.h"
+#include "enginehost.h"
 #include "utils.h"
 #include "interpret.hpp"
+#include "analyse.h"
 
 using namespace std;
 
@@ -42,286 +51,371 @@ using namespace std;
  * The resulting analysis is wrapped in XML.
  */
 
-static const char *VERSION = "2017.04.07";
-
 // The length of algebraic moves expected by a UCI engine.
 #define ALGEBRAIC_MOVELEN 4
+// The hash code of the standard starting position.
+#define START_POSITION_HASH 0x463b96181691fc9cULL
 
-void extractInfo(string& info, vector<string> infoTokens, int searchDepth);
-bool readGame(istream &movestream, vector<string> &movelist,
-        string& fenstring, int& bookDepth);
-void sendGame(vector<string> &movelist, const string& fenstring, int bookDepth);
-void tokenise(string &text, vector<string> &tokens);
+/*
+ * An engine of the pool.
+ */
+struct AnalysisSession::Analyser {
+    // The evaluation engine.
+    Engine *engine;
+    // The number of the game the engine last analysed.
+    size_t gameNumber;
+};
 
-void clearEvaluations(void);
-void escapeForXML(string& str, const string& pattern, const string& escape_str);
-void obtainEvaluations(void);
-bool processMovesFile(const string& movesFile);
-bool processStdin(void);
-bool runEngine(vector<string> files);
-void outputTag(const string& tagLine);
-void saveEvaluation(Evaluation *ev, const string& info);
-bool haveEvaluationForMove(const string &move);
-bool showEvaluationsForMove(const string &move, bool white);
-bool annotateMove(const string &playedMove, bool color);
-void showUsage(const char *programName);
-bool isResult(const string& move);
-bool worse_move(const Evaluation *move, const Evaluation *best);
+/*
+ * A position to be analysed: the moves leading to it,
+ * and the move that was played from it.
+ */
+struct AnalysisSession::PlyJob {
+    // The position the moves leading to this one are played from,
+    // empty for the standard starting position.
+    string fen;
+    // The moves played from fen before this one.
+    string moves;
+    string playedMove;
+    bool white;
+    // Where the move is in the game, for progress reports.
+    int moveCount;
+    int moveTurn;
+    // The hash code of the position, or 0 if it is not known.
+    uint64_t position;
+    // Index into the game's plies of the ply after this one, or -1
+    // if it is not analysed.
+    int next;
+    // The engine's evaluations of the position.
+    vector<Evaluation *> evaluations;
+    // The moves of the best line of the search, if it is a forced mate.
+    string mateLine;
+    // The evaluations were taken from a mating line that the game
+    // followed, not from a search of the position or the cache.
+    bool followedMateLine;
+    // A copy of the best of them, before any played move was added.
+    Evaluation *best;
+    // The played move is to be valued from the next ply's search.
+    bool deferred;
+    // The played move is the only legal move.
+    bool forced;
+    // For a forced move, the index into the game's plies of the first
+    // analysed ply after it whose position has more than one legal move,
+    // and how many plies on that is, when every position in between has
+    // only one, whichever colour is analysed; otherwise -1.
+    int forcedFrom;
+    int forcedSteps;
+};
 
-// Evaluations of the current move.
-static vector<Evaluation *> evaluations;
+/*
+ * A game read from the moves stream, along with the output
+ * produced for it. The output is held until the games before
+ * this one have been written, so that the analysis comes out
+ * in the original order whichever engine finishes first.
+ */
+struct AnalysisSession::GameJob {
+    // The position of the game in the moves stream.
+    size_t number;
+    vector<string> movelist;
+    // The hash code of the position before each move,
+    // from the comments of the moves, or 0 if not known.
+    vector<uint64_t> positions;
+    // Likewise the FEN of the position before each move, or empty.
+    vector<string> fens;
+    // Whether the position before each move has only one legal move.
+    vector<bool> forced;
+    // Whether each move is one of the opening book's moves
+    // for the position before it.
+    vector<bool> book;
+    string fenstring;
+    int bookDepth;
+    // Set by prepareGame.
+    bool prepared = false;
+    bool okToAnalyse;
+    bool startWhite;
+    int movesToSkip;
+    int numMoves;
+    // The positions to be analysed, in the order they were played.
+    vector<PlyJob> plies;
+    // Whether played moves are left to the search of the next ply.
+    bool deferring;
+    // With the plies analysed in order, the last mating line found: its
+    // moves from the position before move mateLineStart, and the mate
+    // in mateMoves that the side to move there has.
+    vector<string> mateLine;
+    int mateLineStart;
+    int mateMoves;
+    // The number of tasks not yet complete.
+    size_t remaining;
+    // The tags and analysis of the game.
+    ostringstream text;
+    // Statistics of the played moves.
+    interpret::Stats stats;
+    // Whether the game was analysed, rather than skipped.
+    bool analysed = false;
+    // Whether the analysis is complete.
+    bool done = false;
+};
 
-// Defaults that are settable by arguments.
-static int defaultBookDepth = 8;
-static unsigned numVariations = 5;
-static int searchDepth = 20;
-static int defaultMovesUntil = 0; // 0 means till the end
-// Default analysis engine.
-static string engineName = "stockfish";
+/*
+ * The analysis of a whole game, or of one of its plies,
+ * by an engine of the pool.
+ */
+struct AnalysisSession::AnalysisTask {
+    GameJob *game;
+    // Index into the game's plies, or ALL_PLIES.
+    int ply;
+};
 
-static map<string, string> engineOptions;
-// Which colours we wish to analyse.
-static bool analyseWhite = true;
-static bool analyseBlack = true;
+// An AnalysisTask for every ply of its game, on the one engine.
+#define ALL_PLIES -1
+
+/*
+ * The tasks waiting for an engine of the pool.
+ */
+struct AnalysisSession::GameQueue {
+    mutex lock;
+    // Signalled when a task is added or the queue is closed.
+    condition_variable queued;
+    // Signalled when an engine completes a game, or a game is added.
+    condition_variable finished;
+    // Signalled when a game has been written.
+    condition_variable written;
+    deque<AnalysisTask> waiting;
+    // Games read but not yet written, in their original order.
+    deque<GameJob *> pending;
+    // No more games will be added.
+    bool closed = false;
+};
+
+void extractInfo(vector<Evaluation *>& evaluations, string_view info, int searchDepth,
+        string *mateLine);
+void keepMatingMoves(const vector<Evaluation *>& evaluations, const Evaluation *ev,
+        string_view pv, string *mateLine);
+void clearEvaluations(vector<Evaluation *>& evaluations);
+void escapeForXML(string& str, const string& pattern, const string& escape_str);
+void saveEvaluation(vector<Evaluation *>& evaluations, Evaluation *ev);
+bool haveEvaluationForMove(const vector<Evaluation *>& evaluations, const string &move);
+bool annotateMove(const vector<Evaluation *>& evaluations, const string &playedMove,
+        bool color, interpret::Stats& stats, ostream& out);
+bool isResult(const string& move);
+bool worse_move(const Evaluation *move, const Evaluation *best);
 
 // A pseudo PGN tag giving the depth, in plies, of
 // previous known play at the point this game was played.
 // These moves are omitted from the analysis.
-static string BOOK_DEPTH_TAG = "BookDepth";
+static const string BOOK_DEPTH_TAG = "BookDepth";
 // Games setup from a FEN description can be analysed.
-static string FEN_TAG = "FEN";
-
-// Whether to output the game with annotations.
-static bool annotate = false;
-// Whether the output is XML.
-static bool XMLformat = true;
-
-// The evaluation engine.
-static Engine *engine;
+static const string FEN_TAG = "FEN";
 
-// Game number record
-static size_t GAME_NUMBER = 0;
+/*
+ * Take the settings for a session from options, the analysis
+ * being written to out.
+ */
+AnalysisSession::AnalysisSession(const AnalysisOptions& options, ostream& out)
+    : defaultBookDepth(options.bookDepth),
+      numVariations(options.variations),
+      searchDepth(options.searchDepth),
+      defaultMovesUntil(options.movesUntil),
+      engineName(options.engineName),
+      engineOptions(options.engineOptions),
+      analyseWhite(options.analyseWhite),
+      analyseBlack(options.analyseBlack),
+      annotate(options.annotate),
+      XMLformat(options.XMLformat),
+      numEngines(options.engines > 0 ? options.engines : 1),
+      splitPlies(options.splitPlies),
+      reuseNextPly(options.reuseNextPly),
+      statsFile(options.statsFile),
+      statsStream(options.statsStream),
+      cacheFile(options.cacheFile),
+      searchTimeout(options.searchTimeout),
+      output(&out),
+      analysedGames(0),
+      cache(new EvalCache),
+      engineHost(NULL) {
+}
 
-// Full filepath of the output PGN
-static string OUTPGN_FILEWPATH = "";
+AnalysisSession::~AnalysisSession() {
+    stopAnalysers();
+    delete cache;
+}
 
-// ARGV INDEX
-#define INPUT_COLOR_SPECIFIC 14
-#define INPUT_COLOR_ALL 15
+/*
+ * Open the evaluation cache, if one is to be used.
+ * The analysis continues without it if it cannot be opened.
+ */
+void AnalysisSession::openCache(void) {
+    if (cacheFile.length() > 0 && !cache->open(cacheFile)) {
+        cerr << "Continuing without the evaluation cache." << endl;
+    }
+}
 
-#ifdef __unix__
+/*
+ * Report the use made of the evaluation cache, and close it.
+ */
+void AnalysisSession::closeCache(void) {
+    if (cache->isOpen()) {
+        cerr << "Evaluation cache: " << cache->getHits() << " hits, " <<
+                cache->getMisses() << " misses (" << cache->getTotalHits() <<
+                " hits, " << cache->getTotalMisses() << " misses in all)" << endl;
+        cache->close();
+    }
+}
 
-int main(int argc, char *argv[]) {
+/*
+ * Start and initialise the engines of the pool.
+ * Return true if they all started.
+ */
+bool AnalysisSession::startAnalysers(void) {
+    analysers.clear();
+#ifdef __linux__
+    // The engines belong to the pool, which initialises them together.
+    try {
+        engineHost = new EngineHost(engineName, numVariations, searchDepth,
+                engineOptions, searchTimeout);
+    } catch (int e) {
+        cerr << "Failed to set up the engine host." << endl;
+        return false;
+    }
+    analysers.resize(numEngines, Analyser{NULL, 0});
+    if (!engineHost->start(numEngines)) {
+        cerr << "Failed to initialise the chess engine." << endl;
+        return false;
+    }
+    engineIdentity = engineHost->getIdentity();
 #else
-
-int main(int argc, char *argv[]) {
-#endif
-
-    if(argc==15) OUTPGN_FILEWPATH = argv[INPUT_COLOR_SPECIFIC];
-    else         OUTPGN_FILEWPATH = argv[INPUT_COLOR_ALL];
-
-    bool ok = true;
-    int argnum = 1;
-
-
-    // Process --arguments.
-    for (; argnum < argc && strncmp(argv[argnum], "--", 2) == 0;) {
-        string arg(argv[argnum]);
-        argnum++;
-
-        if (arg == "--annotate") {
-            annotate = true;
-        } else if (arg == "--annotatePGN") {
-            annotate = true;
-            XMLformat = false;
-        } else if (arg == "--blackonly") {
-            if (analyseBlack) {
-                analyseWhite = false;
-                analyseBlack = true;
-            } else {
-                cerr << arg << " << conflicts with --whiteonly" << endl;
-                ok = false;
-            }
-        } else if (arg == "--bookdepth") {
-            if (argnum < argc) {
-                string depth(argv[argnum]);
-                argnum++;
-                defaultBookDepth = strToInt(depth);
-            } else {
-                cerr << "Missing value argument to " << arg << endl;
-                ok = false;
-            }
-        } else if (arg == "--searchdepth") {
-            if (argnum < argc) {
-                string depth(argv[argnum]);
-                argnum++;
-                searchDepth = strToInt(depth);
-            } else {
-                cerr << "Missing value argument to " << arg << endl;
-                ok = false;
-            }
-        } else if (arg == "--engine") {
-            if (argnum < argc) {
-                engineName = argv[argnum];
-                argnum++;
-            } else {
-                cerr << "Missing engine name argument to " << arg << endl;
-                ok = false;
-            }
-        } else if (arg == "--help") {
-            showUsage(argv[0]);
-        } else if (arg == "--setoption") {
-            if (argnum + 1 < argc) {
-                string name(argv[argnum]);
-                string value(argv[argnum + 1]);
-                argnum += 2;
-
-                engineOptions[name] = value;
-            } else {
-                cerr << "Missing name and/or value argument to " << arg << endl;
-                ok = false;
-            }
-        } else if (arg == "--variations") {
-            if (argnum < argc) {
-                string vars(argv[argnum]);
-                argnum++;
-                numVariations = strToInt(vars);
-            } else {
-                cerr << "Missing value argument to " << arg << endl;
-                ok = false;
-            }
-        } else if (arg == "--version") {
-            cout << "Version: " << VERSION << endl;
-        } else if (arg == "--whiteonly") {
-            if (analyseWhite) {
-                analyseWhite = true;
-                analyseBlack = false;
-            } else {
-                cerr << arg << " << conflicts with --blackonly" << endl;
-                ok = false;
-            }
-        } else if (arg == "--movesuntil") {
-            if (argnum < argc) {
-                string movesUntil(argv[argnum]);
-                argnum++;
-                defaultMovesUntil = strToInt(movesUntil);
-            } else {
-                cerr << "Missing value argument to " << arg << endl;
-                ok = false;
-            }
-        } else {
-            cerr << "Unknown argument: " << arg << endl;
-            ok = false;
+    for (unsigned i = 0; i < numEngines; i++) {
+        Analyser analyser;
+        analyser.gameNumber = 0;
+        try {
+            analyser.engine = new Engine(engineName);
+        } catch (int e) {
+            cerr << "Failed to start " << engineName << endl;
+            return false;
+        }
+        analysers.push_back(analyser);
+        if (!analyser.engine->initEngine(numVariations, searchDepth, engineOptions)) {
+            cerr << "Failed to initialise the chess engine." << endl;
+            return false;
         }
     }
+    engineIdentity = analysers[0].engine->getIdentity();
+#endif
+    return true;
+}
 
-    if (ok) {
-        vector<string> files;
-        for (; argnum < argc; argnum++) {
-            files.push_back(argv[argnum]);
+/*
+ * Shut down the engines of the pool.
+ */
+void AnalysisSession::stopAnalysers(void) {
+    for (unsigned i = 0; i < analysers.size(); i++) {
+        if (analysers[i].engine != NULL) {
+            analysers[i].engine->quitEngine();
+            delete analysers[i].engine;
         }
-        ok = runEngine(files);
-        return ok ? 0 : -1;
-    } else {
-        showUsage(argv[0]);
-        return -2;
-    }
-}
-
-void showUsage(const char *programName) {
-    cerr << "Usage: " << programName << "\n" <<
-            "    [--annotate]\n" <<
-            "        output the games with evaluation annotations\n" <<
-            "    [--annotatePGN]\n" <<
-            "        output the game with evaluation annotations in PGN format\n" <<
-            "    [--blackonly]\n" <<
-            "        only analyse black's moves\n" <<
-            "    [--bookdepth depth]\n" <<
-            "        depth in ply to skip at start of game\n" <<
-            "    [--searchdepth depth]\n" <<
-            "        search depth in ply\n" <<
-            "    [--engine program]\n" <<
-            "        program to use as the UCI engine\n" <<
-            "    [--help]\n" <<
-            "        show this usage message\n" <<
-            "    [--setoption optionName optionValue]\n " <<
-            "        set a UCI option\n" <<
-            "    [--variations vars]\n" <<
-            "        number of variations to analyse per move\n" <<
-            "    [--version]\n" <<
-            "        show the current version\n" <<
-            "    [--whiteonly]\n" <<
-            "        only analyse white's moves\n" <<
-            "    [--movesuntil in ply]\n" <<
-            "        number of moves to analyse before stopping\n" <<
-            "    file [...]\n" <<
-            "        file(s) to be analysed." <<
-            endl;
-    exit(-2);
+    }
+    analysers.clear();
+#ifdef __linux__
+    if (engineHost != NULL && (engineHost->getRestarts() > 0 || engineHost->getTimeouts() > 0)) {
+        cerr << "Engine host: " << engineHost->getRestarts() << " restarts, " <<
+                engineHost->getTimeouts() << " timeouts" << endl;
+    }
+    delete engineHost;
+    engineHost = NULL;
+#endif
 }
 
 /*
- * Run the engine on the given files.
+ * Run the engines on the given files, or on stdin if there are none.
  * Return true if everything was ok.
  */
-bool runEngine(vector<string> files) {
+bool AnalysisSession::analyseFiles(const vector<string>& files) {
     bool ok = true;
-    try {
-        engine = new Engine(engineName);
-        if (engine->initEngine(numVariations, searchDepth, engineOptions)) {
-            if (XMLformat) {
-                cout << "<gamelist>" << endl;
-            }
-            if (files.size() > 0) {
-                // Process each file of moves.
-                for (unsigned i = 0; i < files.size(); i++) {
-                    const string& movesFile = files[i];
-                    if (!annotate) {
-                        cout << "<!-- Processing " << movesFile << "-->" << endl;
-                    }
-                    if (!processMovesFile(movesFile)) {
-                        cerr << "Failed to process " << movesFile << endl;
-                        ok = false;
-                    }
-                    clearEvaluations();
+    openCache();
+    if (startAnalysers()) {
+        if (XMLformat) {
+            *output << "<gamelist>\n";
+        }
+        if (files.size() > 0) {
+            // Process each file of moves.
+            for (unsigned i = 0; i < files.size(); i++) {
+                const string& movesFile = files[i];
+                if (!annotate) {
+                    *output << "<!-- Processing " << movesFile << "-->\n";
                 }
-            } else {
-                if (!processStdin()) {
+                if (!processMovesFile(movesFile)) {
+                    cerr << "Failed to process " << movesFile << endl;
                     ok = false;
                 }
-                clearEvaluations();
             }
         } else {
-            cerr << "Failed to initialise the chess engine." << endl;
-            ok = false;
+            processGames(cin);
         }
         if (XMLformat) {
-            cout << "</gamelist>" << endl;
+            *output << "</gamelist>\n";
         }
+        output->flush();
+    } else {
+        ok = false;
+    }
+    stopAnalysers();
+    closeCache();
 
-        engine->quitEngine();
-        delete engine;
-        engine = NULL;
-    } catch (int e) {
-        cerr << "Failed to start " << engineName << endl;
+    return ok;
+}
+
+/*
+ * Run the engines on the long-algebraic games read from movestream.
+ * Return true if everything was ok.
+ */
+bool AnalysisSession::analyseStream(istream& movestream) {
+    bool ok = true;
+    openCache();
+    if (startAnalysers()) {
+        if (XMLformat) {
+            *output << "<gamelist>\n";
+        }
+        processGames(movestream);
+        if (XMLformat) {
+            *output << "</gamelist>\n";
+        }
+        output->flush();
+    } else {
         ok = false;
     }
+    stopAnalysers();
+    closeCache();
 
     return ok;
 }
 
+/*
+ * Run the engine on the given files.
+ * Return true if everything was ok.
+ */
+bool runEngine(const vector<string>& files, const AnalysisOptions& options) {
+    AnalysisSession session(options, cout);
+    return session.analyseFiles(files);
+}
+
+/*
+ * Run the engine on the long-algebraic games read from movestream,
+ * writing the analysis to out rather than to standard output.
+ * Return true if everything was ok.
+ */
+bool analyseStream(istream& movestream, ostream& out, const AnalysisOptions& options) {
+    AnalysisSession session(options, out);
+    return session.analyseStream(movestream);
+}
+
 /*
  * Process the long-algebraic moves in movesFile.
  */
-bool processMovesFile(const string& movesFile) {
+bool AnalysisSession::processMovesFile(const string& movesFile) {
     ifstream movestream(movesFile.c_str());
     if (movestream.is_open()) {
-        vector<string> moves;
-        string fenstring;
-        int bookDepth;
-        while (readGame(movestream, moves, fenstring, bookDepth)) {
-            sendGame(moves, fenstring, bookDepth);
-        }
+        processGames(movestream);
         movestream.close();
 
         return true;
@@ -332,16 +426,395 @@ bool processMovesFile(const string& movesFile) {
 }
 
 /*
- * Process the long-algebraic moves on stdin
+ * Carry out the tasks queued for the pool with the given engine,
+ * until the queue is closed and empty.
  */
-bool processStdin(void) {
-    vector<string> moves;
-    string fenstring;
-    int bookDepth;
-    while (readGame(cin, moves, fenstring, bookDepth)) {
-        sendGame(moves, fenstring, bookDepth);
+void AnalysisSession::analyseQueuedGames(Analyser *analyser, GameQueue *queue) {
+    unique_lock<mutex> guard(queue->lock);
+    while (true) {
+        queue->queued.wait(guard, [queue] {
+            return queue->closed || !queue->waiting.empty();
+        });
+        if (queue->waiting.empty()) {
+            return;
+        }
+        AnalysisTask task = queue->waiting.front();
+        queue->waiting.pop_front();
+        GameJob *game = task.game;
+
+        guard.unlock();
+        if (task.ply == ALL_PLIES) {
+            if (analyser->gameNumber != game->number) {
+                analyser->engine->startNewGame();
+                analyser->gameNumber = game->number;
+            }
+            for (unsigned i = 0; i < game->plies.size(); i++) {
+                analysePly(*analyser, *game, game->plies[i]);
+            }
+        } else {
+            // What an engine finds depends on the positions it searched before,
+            // so start afresh each time for the results not to depend on
+            // which engine had which of the earlier plies.
+            analyser->engine->startNewGame();
+            analysePly(*analyser, *game, game->plies[task.ply]);
+        }
+        guard.lock();
+
+        game->remaining--;
+        if (game->remaining == 0) {
+            if (game->deferring) {
+                // Every ply is now analysed, so the played moves
+                // left to the next ply can be valued.
+                guard.unlock();
+                valueDeferredMoves(*analyser, *game);
+                guard.lock();
+            }
+            game->done = true;
+            queue->finished.notify_all();
+        }
     }
-    return true;
+}
+
+#ifdef __linux__
+/*
+ * Where an engine of the pool is in its task.
+ */
+struct AnalysisSession::HostedTask {
+    // Whether the engine has a task.
+    bool active = false;
+    AnalysisTask task;
+    // The ply being analysed, and the one after the last of the task.
+    unsigned ply;
+    unsigned endPly;
+    // What is to be done next.
+    enum {
+        START_PLY, AFTER_SEARCH, AFTER_PLAYED_MOVE_SEARCH,
+        DEFERRED_MOVES, AFTER_DEFERRED_SEARCH
+    } stage;
+    // Whether the engine is to be reset before its next search.
+    bool newGame;
+    // Whether the ply's evaluations were searched for, rather than cached.
+    bool searched;
+    // Whether the search being made is of only the played move.
+    bool playedMoveOnly;
+};
+
+/*
+ * Have the engine at index search for the evaluations of the current ply,
+ * of only its played move if playedMoveOnly is set.
+ */
+void AnalysisSession::searchForTask(unsigned index, HostedTask& current, bool playedMoveOnly) {
+    GameJob *game = current.task.game;
+    PlyJob& ply = game->plies[current.ply];
+    engineHost->search(index, current.newGame, ply.moves, ply.fen,
+            playedMoveOnly ? ply.playedMove : "", &ply.evaluations,
+            playedMoveOnly ? NULL : &ply.mateLine);
+    current.newGame = false;
+    current.playedMoveOnly = playedMoveOnly;
+}
+
+/*
+ * Carry on with the task of the engine at index, the same way as
+ * analyseQueuedGames does, until it is waiting for the engine to
+ * complete a search or the task is complete.
+ */
+void AnalysisSession::continueTask(unsigned index, HostedTask& current, GameQueue *queue) {
+    GameJob *game = current.task.game;
+    while (true) {
+        if (current.stage == HostedTask::START_PLY) {
+            if (current.ply == current.endPly) {
+                bool lastTask;
+                {
+                    lock_guard<mutex> guard(queue->lock);
+                    game->remaining--;
+                    lastTask = game->remaining == 0;
+                    if (lastTask && !game->deferring) {
+                        game->done = true;
+                        queue->finished.notify_all();
+                    }
+                }
+                if (lastTask && game->deferring) {
+                    // Every ply is now analysed, so the played moves
+                    // left to the next ply can be valued.
+                    current.ply = 0;
+                    current.stage = HostedTask::DEFERRED_MOVES;
+                    continue;
+                }
+                current.active = false;
+                return;
+            }
+            current.searched = !startPly(*game, game->plies[current.ply]);
+            current.stage = HostedTask::AFTER_SEARCH;
+            if (current.searched) {
+                searchForTask(index, current, false);
+                return;
+            }
+        } else if (current.stage == HostedTask::AFTER_SEARCH) {
+            current.stage = HostedTask::AFTER_PLAYED_MOVE_SEARCH;
+            if (needsPlayedMoveSearch(game->plies[current.ply])) {
+                current.searched = true;
+                searchForTask(index, current, true);
+                return;
+            }
+        } else if (current.stage == HostedTask::AFTER_PLAYED_MOVE_SEARCH) {
+            finishPly(*game, game->plies[current.ply], current.searched);
+            current.ply++;
+            current.stage = HostedTask::START_PLY;
+        } else if (current.stage == HostedTask::DEFERRED_MOVES) {
+            if (current.ply == game->plies.size()) {
+                lock_guard<mutex> guard(queue->lock);
+                game->done = true;
+                queue->finished.notify_all();
+                current.active = false;
+                return;
+            }
+            PlyJob& ply = game->plies[current.ply];
+            if (ply.deferred && !valueFromNextPly(*game, ply)) {
+                current.stage = HostedTask::AFTER_DEFERRED_SEARCH;
+                current.newGame = splitPlies;
+                searchForTask(index, current, true);
+                return;
+            }
+            current.ply++;
+        } else {
+            finishPly(*game, game->plies[current.ply], true);
+            current.ply++;
+            current.stage = HostedTask::DEFERRED_MOVES;
+        }
+    }
+}
+
+/*
+ * Carry out the tasks queued for the pool with every engine of the pool,
+ * from this one thread, until the queue is closed and empty.
+ * The task of an engine that fails, and could not be replaced, is carried
+ * on by another engine from the search that failed.
+ */
+void AnalysisSession::driveEngines(GameQueue *queue) {
+    vector<HostedTask> tasks(analysers.size());
+    deque<EngineHost::Result> results;
+    // Which engines are still working.
+    vector<bool> working(analysers.size(), true);
+    unsigned numWorking = analysers.size();
+    // The tasks whose engine failed, waiting for another one.
+    deque<HostedTask> stranded;
+    while (true) {
+        // Give the stranded and the waiting tasks to the idle engines.
+        vector<unsigned> resumed;
+        vector<unsigned> started;
+        {
+            lock_guard<mutex> guard(queue->lock);
+            bool busy = !stranded.empty();
+            for (unsigned i = 0; i < tasks.size(); i++) {
+                if (!working[i]) {
+                    continue;
+                }
+                if (!tasks[i].active && !stranded.empty()) {
+                    tasks[i] = stranded.front();
+                    stranded.pop_front();
+                    resumed.push_back(i);
+                } else if (!tasks[i].active && !queue->waiting.empty()) {
+                    tasks[i].task = queue->waiting.front();
+                    tasks[i].active = true;
+                    queue->waiting.pop_front();
+                    started.push_back(i);
+                }
+                busy = busy || tasks[i].active;
+            }
+            if (numWorking == 0 && (busy || !queue->waiting.empty())) {
+                FAIL("Every engine has failed, so the analysis cannot be completed.");
+            }
+            if (!busy && queue->closed) {
+                return;
+            }
+        }
+        for (unsigned i = 0; i < resumed.size(); i++) {
+            HostedTask& current = tasks[resumed[i]];
+            analysers[resumed[i]].gameNumber = current.task.game->number;
+            current.newGame = true;
+            searchForTask(resumed[i], current, current.playedMoveOnly);
+        }
+        for (unsigned i = 0; i < started.size(); i++) {
+            HostedTask& current = tasks[started[i]];
+            Analyser& analyser = analysers[started[i]];
+            GameJob *game = current.task.game;
+            if (current.task.ply == ALL_PLIES) {
+                current.ply = 0;
+                current.endPly = game->plies.size();
+            } else {
+                current.ply = current.task.ply;
+                current.endPly = current.task.ply + 1;
+            }
+            current.stage = HostedTask::START_PLY;
+            current.newGame = splitPlies || analyser.gameNumber != game->number;
+            analyser.gameNumber = game->number;
+            continueTask(started[i], current, queue);
+        }
+        if (!started.empty()) {
+            // Some may be complete already, from the cache.
+            continue;
+        }
+
+        if (!engineHost->waitForResults(results)) {
+            FAIL("Failed to wait for the engines.");
+        }
+        while (!results.empty()) {
+            unsigned index = results.front().engine;
+            bool ok = results.front().ok;
+            results.pop_front();
+            if (ok) {
+                continueTask(index, tasks[index], queue);
+            } else {
+                // The engine is given up: its search is made again by another.
+                if (working[index]) {
+                    working[index] = false;
+                    numWorking--;
+                }
+                if (tasks[index].active) {
+                    stranded.push_back(tasks[index]);
+                    tasks[index].active = false;
+                }
+            }
+        }
+    }
+}
+#endif
+
+/*
+ * Tell the engine host that the queue has changed.
+ */
+void AnalysisSession::wakeEngineHost(void) {
+#ifdef __linux__
+    engineHost->wake();
+#endif
+}
+
+/*
+ * Write the output of a completed game and record its statistics.
+ */
+void AnalysisSession::writeGame(GameJob& game) {
+    writeAnalysis(game);
+    *output << game.text.str();
+    // Pass each game on as soon as it is complete.
+    output->flush();
+    if (game.analysed) {
+        analysedGames++;
+        if (statsStream != nullptr) {
+            if(analyseWhite) interpret::recordStats(*statsStream,true,analysedGames,game.stats);
+            if(analyseBlack) interpret::recordStats(*statsStream,false,analysedGames,game.stats);
+            statsStream->flush();
+        } else if (statsFile.length() > 0) {
+            if(analyseWhite) interpret::recordStats(statsFile,true,analysedGames,game.stats);
+            if(analyseBlack) interpret::recordStats(statsFile,false,analysedGames,game.stats);
+        }
+    }
+}
+
+/*
+ * Write out the games of the queue as they are completed, in the
+ * order they were read, until the queue is closed and empty.
+ * This has its own thread so a game is passed on as soon as it
+ * is complete, rather than when the next game has been read.
+ */
+void AnalysisSession::writeCompletedGames(GameQueue *queue) {
+    unique_lock<mutex> guard(queue->lock);
+    while (true) {
+        queue->finished.wait(guard, [queue] {
+            return queue->pending.empty() ? queue->closed : queue->pending.front()->done;
+        });
+        if (queue->pending.empty()) {
+            return;
+        }
+        GameJob *game = queue->pending.front();
+        queue->pending.pop_front();
+
+        guard.unlock();
+        writeGame(*game);
+        delete game;
+        guard.lock();
+
+        queue->written.notify_all();
+    }
+}
+
+/*
+ * Share the games in movestream between the engines of the pool.
+ * Each engine takes the next game, or the next ply if splitPlies is set,
+ * when it is free, and the output is written in the order the games were read.
+ */
+void AnalysisSession::processGames(istream& movestream) {
+    GameQueue queue;
+    vector<thread> workers;
+#ifdef __linux__
+    // One thread drives all of the engines.
+    workers.push_back(thread(&AnalysisSession::driveEngines, this, &queue));
+#else
+    for (unsigned i = 0; i < analysers.size(); i++) {
+        workers.push_back(thread(&AnalysisSession::analyseQueuedGames, this, &analysers[i], &queue));
+    }
+#endif
+    thread writer(&AnalysisSession::writeCompletedGames, this, &queue);
+
+    // Limit how far reading runs ahead of the slowest game.
+    size_t maxPending = 2 * analysers.size();
+    // Numbers start from 1 as an engine's gameNumber of 0 means none.
+    size_t gamesRead = 0;
+    bool moreGames = true;
+    while (moreGames) {
+        GameJob *game = new GameJob;
+        game->number = ++gamesRead;
+        moreGames = readGame(movestream, *game);
+        if (moreGames) {
+            prepareGame(*game);
+        }
+
+        unique_lock<mutex> guard(queue.lock);
+        queue.written.wait(guard, [&queue, maxPending] {
+            return queue.pending.size() < maxPending;
+        });
+        if (game->plies.empty()) {
+            // Nothing to analyse but whatever was read still has to be written.
+            game->done = true;
+        } else if (splitPlies) {
+            game->remaining = game->plies.size();
+            for (unsigned i = 0; i < game->plies.size(); i++) {
+                queue.waiting.push_back(AnalysisTask{game, (int) i});
+            }
+            queue.queued.notify_all();
+            wakeEngineHost();
+        } else {
+            game->remaining = 1;
+            queue.waiting.push_back(AnalysisTask{game, ALL_PLIES});
+            queue.queued.notify_one();
+            wakeEngineHost();
+        }
+        queue.pending.push_back(game);
+        queue.finished.notify_all();
+    }
+
+    {
+        lock_guard<mutex> guard(queue.lock);
+        queue.closed = true;
+        queue.queued.notify_all();
+        queue.finished.notify_all();
+        wakeEngineHost();
+    }
+    for (unsigned i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    writer.join();
+}
+
+/*
+ * The halfmove clock of a FEN: the plies since the last capture or
+ * pawn move. Zero if the FEN is empty or has no clock.
+ */
+static int halfmoveClock(const string& fen) {
+    istringstream fields(fen);
+    string placement, toMove, castling, enPassant;
+    int clock = 0;
+    fields >> placement >> toMove >> castling >> enPassant >> clock;
+    return fields ? clock : 0;
 }
 
 /* Extract the string between quotes as the value of a tag. */
@@ -362,16 +835,30 @@ static string extractTagValue(const string& line) {
 }
 
 /*
- * Read moves for one game from movestream and store them in the moves vector.
- * Set any FEN tag value and book depth.
+ * Read moves for one game from movestream and store them in the game's moves.
+ * Set any FEN tag value and book depth, and output its tags.
  * The end of a game is marked by a zero-length line or the end of file.
  * Return true on success; false otherwise.
  */
-bool readGame(istream &movestream, vector<string> &movelist,
-        string& fenstring, int& bookDepth) {
+bool AnalysisSession::readGame(istream& movestream, GameJob& game) {
+    vector<string>& movelist = game.movelist;
+    vector<uint64_t>& positions = game.positions;
+    vector<string>& fens = game.fens;
+    vector<bool>& forced = game.forced;
+    vector<bool>& book = game.book;
+    string& fenstring = game.fenstring;
+    int& bookDepth = game.bookDepth;
+    ostream& out = game.text;
     string line;
     bool endOfGame = false;
+    // Whether a comment continues from the previous line.
+    bool inComment = false;
+    string comment;
     movelist.clear();
+    positions.clear();
+    fens.clear();
+    forced.clear();
+    book.clear();
     fenstring = "";
     bookDepth = defaultBookDepth;
 
@@ -386,8 +873,8 @@ bool readGame(istream &movestream, vector<string> &movelist,
         return false;
     }
     if (XMLformat) {
-        cout << "<game>" << endl;
-        cout << "<tags>" << endl;
+        out << "<game>\n";
+        out << "<tags>\n";
     }
 
     while (line.size() > 0 && line[0] == '[' && !endOfGame) {
@@ -407,28 +894,75 @@ bool readGame(istream &movestream, vector<string> &movelist,
             fenstring = extractTagValue(line);
         }
         // Output tags.
-        outputTag(line);
+        outputTag(line, out);
         if (!movestream.good() || !getline(movestream, line)) {
             endOfGame = true;
         }
     }
 
     if (XMLformat) {
-        cout << "</tags>" << endl;
+        out << "</tags>\n";
     }
 
     if (!annotate) {
-        cout << "<moves>" << endl;
+        out << "<moves>\n";
     }
 
+    // The position before the first move.
+    positions.push_back(fenstring.length() > 0 ? 0 : START_POSITION_HASH);
+    fens.push_back(fenstring);
+    forced.push_back(false);
+    book.push_back(false);
+
     while (movestream.good() && !endOfGame) {
-        if (!annotate && line.size() > 0) {
-            cout << line << endl;
-        }
         if (line.size() > 0) {
             stringstream moves(line);
             string move;
+            // The line without its comments.
+            string movesText;
             while (moves >> move) {
+                // A comment following a move holds the hash code or
+                // the FEN of the position it leads to, or marks it as
+                // having only one legal move, or the move itself as
+                // one of the opening book's.
+                if (inComment || move[0] == '{') {
+                    if (!inComment) {
+                        comment.clear();
+                    }
+                    size_t start = inComment ? 0 : 1;
+                    size_t end = move.find('}', start);
+                    inComment = end == string::npos;
+                    string text = move.substr(start, inComment ? string::npos : end - start);
+                    if (text.length() > 0) {
+                        if (comment.length() > 0) {
+                            comment.append(" ");
+                        }
+                        comment.append(text);
+                    }
+                    if (!inComment && comment.length() > 0 && positions.size() == movelist.size() + 1) {
+                        if (comment == "forced") {
+                            forced.back() = true;
+                        } else if (comment == "book") {
+                            if (!movelist.empty()) {
+                                book[movelist.size() - 1] = true;
+                            }
+                        } else if (comment.find('/') != string::npos) {
+                            fens.back() = comment;
+                        } else {
+                            positions.back() = strtoull(comment.c_str(), NULL, 16);
+                        }
+                    }
+                    continue;
+                }
+                if (movesText.length() > 0) {
+                    movesText.append(" ");
+                }
+                movesText.append(move);
+                // Not known until its comment is seen.
+                positions.push_back(0);
+                fens.push_back("");
+                forced.push_back(false);
+                book.push_back(false);
                 // Drop any suffixes, such as + and #
                 // but retain promotions.
                 if (isResult(move)) {
@@ -449,6 +983,9 @@ bool readGame(istream &movestream, vector<string> &movelist,
                     movelist.push_back(move);
                 }
             }
+            if (!annotate && movesText.length() > 0) {
+                out << movesText << "\n";
+            }
         } else {
             // Blank line.
         }
@@ -458,24 +995,30 @@ bool readGame(istream &movestream, vector<string> &movelist,
     }
 
     if (!annotate) {
-        cout << "</moves>" << endl;
+        out << "</moves>\n";
     } else {
-        cout << endl;
+        out << "\n";
     }
     return movelist.size() > 0;
 }
 
 /*
- * Send the moves of a game, one by one, to the engine.
+ * Work out which plies of a game are to be analysed,
+ * and the position before each of them.
  */
-void sendGame(vector<string> &movelist, const string& fenstring, int bookDepth) {
+void AnalysisSession::prepareGame(GameJob& game) {
+    const vector<string>& movelist = game.movelist;
+    const string& fenstring = game.fenstring;
+    int bookDepth = game.bookDepth;
 
     // Don't include the result.
     int numMoves = movelist.size() - 1;
     // The string of moves that is gradually built up.
     string moves = "";
+    // Where each move starts in moves.
+    vector<size_t> moveStarts;
     // Might be set from the FEN string.
-    bool white;
+    bool white = true;
     // Index into moves from the list.
     int moveCount = 0;
 
@@ -510,39 +1053,26 @@ void sendGame(vector<string> &movelist, const string& fenstring, int bookDepth)
         white = true;
     }
 
+    game.prepared = true;
+    game.okToAnalyse = okToAnalyse;
+    game.startWhite = white;
+    game.movesToSkip = movesToSkip;
+    game.plies.clear();
+    game.deferring = reuseNextPly;
+    game.mateLine.clear();
+
     if (okToAnalyse) {
-        if (annotate) {
-            if (XMLformat) {
-                cout << "<annotation>" << endl;
-            }
-        } else {
-            cout << "<analysis " <<
-                    "engine = \"" << engine->getIdentity() << "\" " <<
-                    "bookDepth = \"" << bookDepth << "\" " <<
-                    "searchDepth = \"" << searchDepth << "\" " <<
-                    "variations = \"" << numVariations << "\" " <<
-                    ">" << endl;
-        }
-        engine->startNewGame();
         // Skip over the portion considered to be book.
         while (moveCount < movesToSkip) {
-            if (annotate) {
-                cout << movelist[moveCount] << " ";
-            }
+            moveStarts.push_back(moves.length());
             moves.append(movelist[moveCount]);
             moves.append(" ");
             moveCount++;
             white = !white;
         }
 
-        #ifdef __linux__
-        int total_moves = movelist.size();
-        #endif
         int moveTurn = 0;
 
-        interpret::clearStats();
-        GAME_NUMBER++;
-
         if(defaultMovesUntil && defaultMovesUntil < numMoves && defaultMovesUntil > movesToSkip) {
             numMoves = defaultMovesUntil;
         }
@@ -551,96 +1081,397 @@ void sendGame(vector<string> &movelist, const string& fenstring, int bookDepth)
 
             if(moveCount%2==0) moveTurn++;
 
-            #ifdef __linux__
-            cerr << "Turn : " << moveTurn << " | analyzing move " << moveCount+1 << "/" << total_moves-1;
-            cerr << "\t depth of = " << searchDepth << "\n";
-            #endif
-
             const string& playedMove = movelist[moveCount];
-            // Only analyse a move for a particular colour if required.
-            if ((white && analyseWhite) || (!white && analyseBlack)) {
-                // Ask the engine to analyse the current position.
-                engine->setPosition(moves, fenstring);
-                engine->go();
-
-                // Start with a fresh set of evaluations.
-                clearEvaluations();
-                obtainEvaluations();
-
-                // Make sure we have an analysis for the played move.
-                if (!haveEvaluationForMove(playedMove)) {
-                    // The played move wasn't analysed, so force it to be.
-                    engine->setPosition(moves, fenstring);
-                    engine->searchMoves(playedMove);
-                    // Add it to the current ones.
-                    obtainEvaluations();
+            moveStarts.push_back(moves.length());
+            // Only analyse a move for a particular colour if required,
+            // and not at all if it is an opening book move.
+            if (((white && analyseWhite) || (!white && analyseBlack)) && !game.book[moveCount]) {
+                PlyJob ply;
+                // Start from the last capture or pawn move, when its FEN is
+                // known, as no earlier position can be repeated after it.
+                int base = moveCount - halfmoveClock(game.fens[moveCount]);
+                if (base > 0 && base <= moveCount && game.fens[base].length() > 0) {
+                    ply.fen = game.fens[base];
+                    ply.moves = moves.substr(moveStarts[base]);
+                } else {
+                    ply.fen = fenstring;
+                    ply.moves = moves;
+                }
+                ply.playedMove = playedMove;
+                ply.white = white;
+                ply.moveCount = moveCount;
+                ply.moveTurn = moveTurn;
+                ply.position = game.positions[moveCount];
+                ply.next = -1;
+                ply.best = NULL;
+                ply.deferred = false;
+                ply.forced = game.forced[moveCount];
+                ply.forcedFrom = -1;
+                ply.forcedSteps = 0;
+                ply.followedMateLine = false;
+                if (!game.plies.empty() && game.plies.back().moveCount == moveCount - 1) {
+                    game.plies.back().next = game.plies.size();
+                }
+                game.plies.push_back(ply);
+            }
+
+            moves.append(playedMove);
+            moves.append(" ");
+            white = !white;
+        }
+        // A forced move is valued from the search of the next position
+        // with a choice of moves, when that is analysed and only forced
+        // moves lead to it, rather than being searched itself.
+        vector<int> plyAt(numMoves, -1);
+        for (unsigned i = 0; i < game.plies.size(); i++) {
+            plyAt[game.plies[i].moveCount] = i;
+        }
+        for (PlyJob& ply : game.plies) {
+            if (ply.forced) {
+                int from = ply.moveCount + 1;
+                while (from < numMoves && game.forced[from]) {
+                    from++;
+                }
+                if (from < numMoves && plyAt[from] >= 0) {
+                    ply.forcedFrom = plyAt[from];
+                    ply.forcedSteps = from - ply.moveCount;
+                    game.deferring = true;
                 }
+            }
+        }
+    }
+    game.numMoves = numMoves;
+}
+
+/*
+ * Have the analyser's engine evaluate the position before a ply.
+ */
+void AnalysisSession::analysePly(Analyser& analyser, GameJob& game, PlyJob& ply) {
+    Engine *engine = analyser.engine;
+
+    bool known = startPly(game, ply);
+    if (!known) {
+        // Ask the engine to analyse the current position.
+        engine->setPosition(ply.moves, ply.fen);
+        engine->go();
+        obtainEvaluations(engine, ply.evaluations, &ply.mateLine);
+    }
+
+    bool searched = !known;
+    if (needsPlayedMoveSearch(ply)) {
+        searchPlayedMove(engine, ply);
+        searched = true;
+    }
+    finishPly(game, ply, searched);
+}
+
+/*
+ * Start the analysis of a ply with a fresh set of evaluations,
+ * taken from the cache if it has them, or from a mating line that
+ * the game has followed.
+ * Return whether they were, or whether the ply has only one legal
+ * move, which needs no search when the next ply is to be analysed.
+ */
+bool AnalysisSession::startPly(GameJob& game, PlyJob& ply) {
+    #ifdef __linux__
+    int total_moves = game.movelist.size();
+    cerr << "Turn : " << ply.moveTurn << " | analyzing move " << ply.moveCount+1 << "/" << total_moves-1;
+    cerr << "\t depth of = " << searchDepth << "\n";
+    #endif
+
+    clearEvaluations(ply.evaluations);
+    ply.mateLine.clear();
+    ply.followedMateLine = false;
+    if (cache->isOpen() && ply.position != 0 && cache->lookup(ply.position,
+            engineIdentity, searchDepth, numVariations, ply.evaluations)) {
+        return true;
+    }
+    if (followMateLine(game, ply)) {
+        ply.followedMateLine = true;
+        return true;
+    }
+    return ply.forced && ply.forcedFrom >= 0;
+}
 
+/*
+ * Give a ply the evaluation of the next move of the last mating line
+ * found, if the game has followed the line so far.
+ * Return whether it did; the line is forgotten once the game leaves it.
+ */
+bool AnalysisSession::followMateLine(GameJob& game, PlyJob& ply) {
+    int steps = ply.moveCount - game.mateLineStart;
+    if (game.mateLine.empty() || steps <= 0 || steps >= (int) game.mateLine.size()) {
+        return false;
+    }
+    int mateMoves = game.mateMoves;
+    for (int i = 0; i < steps; i++) {
+        if (game.movelist[game.mateLineStart + i] != game.mateLine[i]) {
+            game.mateLine.clear();
+            return false;
+        }
+        // After a move of the line, mate in n for the mover is mate
+        // in -(n - 1) for the other side, and being mated in n is mate
+        // in n for it.
+        mateMoves = mateMoves > 0 ? 1 - mateMoves : -mateMoves;
+    }
+    Evaluation *ev = new Evaluation(1, searchDepth, 0, true, mateMoves,
+            false, false, game.mateLine[steps]);
+    saveEvaluation(ply.evaluations, ev);
+    return true;
+}
+
+/*
+ * Remember the best line of a ply if it is a forced mate and the
+ * game follows it, so that the plies after it need not be searched.
+ * Only when the plies of a game are analysed in order, and not with
+ * the evaluation cache, which does not keep the lines: a ply found in
+ * it would leave nothing to follow, so the analysis would depend on
+ * what the cache held.
+ */
+void AnalysisSession::keepMateLine(GameJob& game, const PlyJob& ply) {
+    if (splitPlies || cache->isOpen() || ply.evaluations.empty()) {
+        return;
+    }
+    const Evaluation *best = ply.evaluations[0];
+    if (!best->isForcedMate() || best->getFirstMove() != ply.playedMove) {
+        return;
+    }
+    vector<string> line;
+    istringstream moves(ply.mateLine);
+    string move;
+    while (moves >> move) {
+        line.push_back(move);
+    }
+    if (line.size() < 2 || line[0] != ply.playedMove) {
+        return;
+    }
+    game.mateLine = line;
+    game.mateLineStart = ply.moveCount;
+    game.mateMoves = best->getNumMateMoves();
+}
+
+/*
+ * Check, once the position has been analysed, that there is an
+ * analysis of the played move.
+ * Return whether the played move must be searched on its own.
+ */
+bool AnalysisSession::needsPlayedMoveSearch(PlyJob& ply) {
+    if (!ply.evaluations.empty()) {
+        // For valuing the move before this one, if it is deferred.
+        ply.best = new Evaluation(*ply.evaluations[0]);
+    }
+    if (haveEvaluationForMove(ply.evaluations, ply.playedMove)) {
+        return false;
+    } else if ((reuseNextPly && ply.next >= 0) || (ply.forced && ply.forcedFrom >= 0)) {
+        // Left until the next ply has been analysed.
+        ply.deferred = true;
+        return false;
+    } else {
+        return true;
+    }
+}
+
+/*
+ * Keep the evaluations of a ply in the cache if they were searched for,
+ * and any mating line they found.
+ */
+void AnalysisSession::finishPly(GameJob& game, PlyJob& ply, bool searched) {
+    // The single line of a followed mate is not a full search of the
+    // position, even with the played move searched too.
+    if (searched && !ply.followedMateLine && cache->isOpen() && ply.position != 0) {
+        cache->store(ply.position, engineIdentity, searchDepth,
+                numVariations, ply.evaluations);
+    }
+    keepMateLine(game, ply);
+}
+
+/*
+ * Force the engine to analyse the played move of a ply,
+ * adding it to the ply's evaluations.
+ */
+void AnalysisSession::searchPlayedMove(Engine *engine, PlyJob& ply) {
+    engine->setPosition(ply.moves, ply.fen);
+    engine->searchMoves(ply.playedMove);
+    obtainEvaluations(engine, ply.evaluations, NULL);
+}
+
+/*
+ * Value the played moves that were left to the search of the
+ * following ply, once every ply of the game has been analysed.
+ * The move is searched as usual if that search cannot be used.
+ */
+void AnalysisSession::valueDeferredMoves(Analyser& analyser, GameJob& game) {
+    for (unsigned i = 0; i < game.plies.size(); i++) {
+        PlyJob& ply = game.plies[i];
+        if (ply.deferred && !valueFromNextPly(game, ply)) {
+            if (splitPlies) {
+                analyser.engine->startNewGame();
+            }
+            searchPlayedMove(analyser.engine, ply);
+            finishPly(game, ply, true);
+        }
+    }
+}
+
+/*
+ * Value the deferred played move of a ply from the search of the next ply:
+ * the value of the best line from the position after the move is the
+ * negation of the move's value. A forced move is valued from the first
+ * position with a choice of moves after it, each forced move in between
+ * having the negation of the value after it.
+ * Return false if that search did not reach the full depth, as at the
+ * end of the game, so the move is to be searched after all.
+ */
+bool AnalysisSession::valueFromNextPly(GameJob& game, PlyJob& ply) {
+    ply.deferred = false;
+    int from = ply.forced ? ply.forcedFrom : ply.next;
+    int steps = ply.forced ? ply.forcedSteps : 1;
+    const Evaluation *reply = game.plies[from].best;
+    if (reply == NULL || reply->getDepth() < searchDepth) {
+        return false;
+    }
+    int value = reply->getValue();
+    int mateMoves = reply->isForcedMate() ? reply->getNumMateMoves() : 0;
+    for (int i = 0; i < steps; i++) {
+        value = -value;
+        if (reply->isForcedMate()) {
+            // Mate in n for the side to move after the move is mate
+            // in -n for the mover, and being mated in n after it is
+            // mate in n + 1 for the mover, counting the move itself.
+            mateMoves = mateMoves > 0 ? -mateMoves : 1 - mateMoves;
+        }
+    }
+    Evaluation *ev = new Evaluation(1, reply->getDepth(), value,
+            reply->isForcedMate(), mateMoves,
+            reply->isUpperBound(), reply->isLowerBound(), ply.playedMove);
+    saveEvaluation(ply.evaluations, ev);
+    return true;
+}
+
+/*
+ * Output the analysis of a game, once all of its plies
+ * have been analysed, and collect its statistics.
+ */
+void AnalysisSession::writeAnalysis(GameJob& game) {
+    if (!game.prepared) {
+        return;
+    }
+    const vector<string>& movelist = game.movelist;
+    ostream& out = game.text;
+    bool white = game.startWhite;
+    int moveCount = 0;
+    // The next of the analysed plies.
+    unsigned plyIndex = 0;
+
+    if (game.okToAnalyse) {
+        if (annotate) {
+            if (XMLformat) {
+                out << "<annotation>\n";
+            }
+        } else {
+            out << "<analysis " <<
+                    "engine = \"" << engineIdentity << "\" " <<
+                    "bookDepth = \"" << game.bookDepth << "\" " <<
+                    "searchDepth = \"" << searchDepth << "\" " <<
+                    "variations = \"" << numVariations << "\" " <<
+                    ">\n";
+        }
+        // Skip over the portion considered to be book.
+        while (moveCount < game.movesToSkip) {
+            if (annotate) {
+                out << movelist[moveCount] << " ";
+            }
+            moveCount++;
+            white = !white;
+        }
+
+        interpret::clearStats(game.stats);
+        game.analysed = true;
+
+        for (; moveCount < game.numMoves; moveCount++) {
+            const string& playedMove = movelist[moveCount];
+            if (plyIndex < game.plies.size() && game.plies[plyIndex].moveCount == moveCount) {
+                PlyJob& ply = game.plies[plyIndex++];
                 bool playedMoveEvaluated;
                 if (annotate) {
-                    playedMoveEvaluated = annotateMove(playedMove,white);
+                    playedMoveEvaluated = annotateMove(ply.evaluations, playedMove, white, game.stats, out);
                 } else {
-                    playedMoveEvaluated = showEvaluationsForMove(playedMove, white);
+                    playedMoveEvaluated = showEvaluationsForMove(ply.evaluations, playedMove, white, out);
                 }
                 if (!playedMoveEvaluated) {
                     cerr << "Internal error: " << playedMove <<
                             " was not evaluated." << endl;
                 }
+                clearEvaluations(ply.evaluations);
+                delete ply.best;
+                ply.best = NULL;
             }
-            else cout << " " << playedMove << " " ;
+            else out << " " << playedMove << " " ;
 
-            moves.append(playedMove);
-            moves.append(" ");
             white = !white;
         }
 
-        if(analyseWhite) interpret::recordStats(OUTPGN_FILEWPATH,true,GAME_NUMBER);
-        if(analyseBlack) interpret::recordStats(OUTPGN_FILEWPATH,false,GAME_NUMBER);
-
         if (annotate) {
             // Output the result.
-            cout << movelist[movelist.size() - 1] << endl;
+            out << movelist[movelist.size() - 1] << "\n";
             if (XMLformat) {
-                cout << "</annotation>" << endl;
+                out << "</annotation>\n";
             }
         } else {
-            cout << "</analysis>" << endl;
+            out << "</analysis>\n";
         }
     }
     if (XMLformat) {
-        cout << "</game>" << endl;
+        out << "</game>\n";
     } else {
-        cout << endl;
+        out << "\n";
     }
 }
 
 /*
  * Extract the information from an info line returned
- * by the engine.
+ * by the engine, keeping the moves of the best line in
+ * mateLine, if it is given.
  */
-void extractInfo(string &info, vector<string> infoTokens, int searchDepth) {
-    ASSERT_IS("info", infoTokens[0]);
-    if (info.find("multipv ") != string::npos) {
-        int numTokens = infoTokens.size();
-        int t = 1;
-        while (t < numTokens && infoTokens[t] != "depth") {
-            t++;
-        }
-        if (t < numTokens) {
-            int depth = strToInt(infoTokens[t + 1]);
-            if (depth == searchDepth) {
-                Evaluation *ev = new Evaluation(infoTokens, info);
-                saveEvaluation(ev, info);
-            }
+void extractInfo(vector<Evaluation *>& evaluations, string_view info, int searchDepth,
+        string *mateLine) {
+    Evaluation ev;
+    string_view pv;
+    if (ev.parseInfo(info, searchDepth, &pv)) {
+        Evaluation *saved = new Evaluation(ev);
+        saveEvaluation(evaluations, saved);
+        keepMatingMoves(evaluations, saved, pv, mateLine);
+    }
+}
+
+/*
+ * Keep the moves, pv, of the line of ev, just saved in evaluations,
+ * in mateLine, if it is given and ev is now the best evaluation and
+ * a forced mate. Only the best line's moves are kept, so those of
+ * a line that has been evaluated again are forgotten otherwise.
+ */
+void keepMatingMoves(const vector<Evaluation *>& evaluations, const Evaluation *ev,
+        string_view pv, string *mateLine) {
+    if (mateLine == NULL) {
+        return;
+    }
+    if (evaluations[0] == ev && ev->isForcedMate()) {
+        size_t start = pv.find_first_not_of(' ');
+        if (start == string_view::npos) {
+            mateLine->clear();
+        } else {
+            mateLine->assign(pv.data() + start, pv.size() - start);
         }
+    } else if (mateLine->compare(0, mateLine->find(' '), ev->getFirstMove()) == 0) {
+        mateLine->clear();
     }
 }
 
 /*
  * Do we have an evaluation for the played move?
  */
-bool haveEvaluationForMove(const string &move) {
-    for (vector<Evaluation *>::iterator it = evaluations.begin();
+bool haveEvaluationForMove(const vector<Evaluation *>& evaluations, const string &move) {
+    for (vector<Evaluation *>::const_iterator it = evaluations.begin();
             it != evaluations.end(); it++) {
         const Evaluation *ev = *it;
         if (ev->getFirstMove() == move) {
@@ -655,45 +1486,46 @@ bool haveEvaluationForMove(const string &move) {
  * given played move.
  * Return whether the played move was evaluated.
  */
-bool showEvaluationsForMove(const string &playedMove, bool white) {
-    cout << "<move player = " <<
+bool AnalysisSession::showEvaluationsForMove(const vector<Evaluation *>& evaluations,
+        const string& playedMove, bool white, ostream& out) {
+    out << "<move player = " <<
             '"' << (white ? "white" : "black") << '"' <<
-            " >" << endl;
-    cout << "<played";
-    // cout << " time = " << '"' << evaluations[0]->getTime() << '"' ;
-    cout << '>';
-    cout << playedMove << "</played>" << endl;
+            " >\n";
+    out << "<played";
+    // out << " time = " << '"' << evaluations[0]->getTime() << '"' ;
+    out << '>';
+    out << playedMove << "</played>\n";
 
     // Whether the playedMove was one of those evaluated.
     bool playedMoveEvaluated = false;
 
-    for (vector<Evaluation *>::iterator it = evaluations.begin();
+    for (vector<Evaluation *>::const_iterator it = evaluations.begin();
             it != evaluations.end(); it++) {
         const Evaluation *ev = *it;
         string firstMove = ev->getFirstMove();
         if (ev != NULL) {
             if (!annotate) {
-                cout << "<evaluation move = " << '"' << firstMove << '"';
-                cout << " value = " << '"';
+                out << "<evaluation move = " << '"' << firstMove << '"';
+                out << " value = " << '"';
                 if (ev->isForcedMate()) {
-                    cout << "mate " << ev->getNumMateMoves();
+                    out << "mate " << ev->getNumMateMoves();
                 } else {
-                    cout << ev->getValue();
+                    out << ev->getValue();
                     if (ev->isLowerBound()) {
-                        cout << " L";
+                        out << " L";
                     } else if (ev->isUpperBound()) {
-                        cout << " U";
+                        out << " U";
                     }
                 }
-                cout << "\" />";
-                cout << endl;
+                out << "\" />";
+                out << "\n";
             }
             if (firstMove == playedMove) {
                 playedMoveEvaluated = true;
             }
         }
     }
-    cout << "</move>" << endl;
+    out << "</move>\n";
     return playedMoveEvaluated;
 }
 
@@ -701,11 +1533,10 @@ bool showEvaluationsForMove(const string &playedMove, bool white) {
  * Show the evaluation for the played move and the best alternative.
  * Return whether the played move was evaluated.
  */
-bool annotateMove(const string &playedMove, bool color) {
+bool annotateMove(const vector<Evaluation *>& evaluations, const string &playedMove,
+        bool color, interpret::Stats& stats, ostream& out) {
 
-    interpret::initializeOStream();
-
-    vector<Evaluation *>::iterator it = evaluations.begin();
+    vector<Evaluation *>::const_iterator it = evaluations.begin();
     while (it != evaluations.end() && (*it)->getFirstMove() != playedMove) {
         it++;
     }
@@ -758,18 +1589,18 @@ bool annotateMove(const string &playedMove, bool color) {
             
         } while (it != evaluations.end() && !worse_move(*it, best));
 
-        cout << playedMoveSTDOUT;
+        out << playedMoveSTDOUT;
         
         if(noMateYet)
-            interpret::playedMove(playedMoveEval,bestMoveEval,color);
+            interpret::playedMove(playedMoveEval,bestMoveEval,color,stats,out);
         
-        cout << " } ";
-        cout << bestMoveSTDOUT;
-        cout << endl;
+        out << " } ";
+        out << bestMoveSTDOUT;
+        out << "\n";
 
         return true;
     } else {
-        cout << endl;
+        out << "\n";
         return false;
     }
 }
@@ -812,25 +1643,25 @@ bool worse_move(const Evaluation *move, const Evaluation *best)
  * Ensure that special characters are escaped to fit with
  * XML.
  */
-void outputTag(const string& tagLine) {
+void AnalysisSession::outputTag(const string& tagLine, ostream& out) {
     // The tag name.
     int first_quote = tagLine.find_first_of("\"");
     int last_quote = tagLine.find_last_of("\"");
     if (XMLformat) {
-        cout << "<tag name = \"";
+        out << "<tag name = \"";
     } else {
-        cout << "[";
+        out << "[";
     }
-    cout << tagLine.substr(1, first_quote - 2);
+    out << tagLine.substr(1, first_quote - 2);
     if (XMLformat) {
-        cout << "\"";
+        out << "\"";
     }
 
     // The value.
     if (XMLformat) {
-        cout << " value = ";
+        out << " value = ";
     } else {
-        cout << " ";
+        out << " ";
     }
     string value = tagLine.substr(first_quote + 1, last_quote - first_quote - 1);
     escapeForXML(value, "&", "&amp;");
@@ -841,11 +1672,11 @@ void outputTag(const string& tagLine) {
         value.replace(qindex, 2, "&quot;");
         qindex = value.find_first_of(escaped_quote);
     }
-    cout << "\"" << value << "\"";
+    out << "\"" << value << "\"";
     if (XMLformat) {
-        cout << " />" << endl;
+        out << " />\n";
     } else {
-        cout << "]" << endl;
+        out << "]\n";
     }
 }
 
@@ -865,7 +1696,7 @@ void escapeForXML(string& str, const string& pattern, const string& escape_str)
 /*
  * Store the given evaluation in the evaluations array.
  */
-void saveEvaluation(Evaluation *ev, const string& info) {
+void saveEvaluation(vector<Evaluation *>& evaluations, Evaluation *ev) {
     bool inserted = false;
     vector<Evaluation *>::iterator it = evaluations.begin();
     // Look for an existing occurrence.
@@ -943,25 +1774,23 @@ void saveEvaluation(Evaluation *ev, const string& info) {
 
 /*
  * Obtain the evaluations from the engine.
- * Fill out the evaluations array.
+ * Fill out the evaluations array, and mateLine if it is given.
  */
-void obtainEvaluations(void) {
-    string reply;
-    vector<string> tokens;
+void AnalysisSession::obtainEvaluations(Engine *engine, vector<Evaluation *>& evaluations,
+        string *mateLine) {
+    string_view reply;
     bool bestMoveFound = false;
     bool eof = false;
 
     do {
         reply = engine->getResponse(eof);
         if (!eof) {
-            // Break up the reply.
-            tokens.clear();
-            tokenise(reply, tokens);
-            if (tokens.size() > 0) {
-                string tokenType = tokens[0];
-                if (tokenType == "info") {
-                    extractInfo(reply, tokens, searchDepth);
-                } else if (tokenType == "bestmove") {
+            // Only the first word of the reply is needed to tell its type.
+            size_t start = reply.find_first_not_of(' ');
+            if (start != string_view::npos) {
+                if (reply.compare(start, 5, "info ") == 0) {
+                    extractInfo(evaluations, reply, searchDepth, mateLine);
+                } else if (reply.compare(start, 8, "bestmove") == 0) {
                     bestMoveFound = true;
                 }
             }
@@ -972,7 +1801,7 @@ void obtainEvaluations(void) {
 /*
  * Clear the evaluations array.
  */
-void clearEvaluations(void) {
+void clearEvaluations(vector<Evaluation *>& evaluations) {
     for (vector<Evaluation *>::iterator it = evaluations.begin();
             it != evaluations.end(); it++) {
         Evaluation *eval = *it;
@@ -983,20 +1812,6 @@ void clearEvaluations(void) {
     evaluations.clear();
 }
 
-/*
- * Tokenise text into tokens.
- * tokens is not cleared by this function.
- */
-void tokenise(string &text, vector<string> &tokens) {
-    stringstream ss(text);
-    string token;
-    while (getline(ss, token, ' ')) {
-        if (token != "") {
-            tokens.push_back(token);
-        }
-    }
-}
-
 bool isResult(const string& move) {
     return move == "1-0" ||
             move == "0-1" ||
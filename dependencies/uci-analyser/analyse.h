@@ -0,0 +1,193 @@
+/*
+ *  This file is part of uci-analyser: a UCI-based Chess Game Analyser
+ *  Copyright (C) 2013-2017 David J. Barnes
+ *
+ *  uci-analyser is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  uci-analyser is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with uci-analyser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#ifndef ANALYSE_H
+#define ANALYSE_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * The settings of an analysis run.
+ * These correspond to the program's --arguments.
+ */
+struct AnalysisOptions {
+    // Depth in ply to skip at start of game.
+    int bookDepth = 8;
+    // Number of variations to analyse per move.
+    unsigned variations = 5;
+    // Search depth in ply.
+    int searchDepth = 20;
+    // Number of moves to analyse before stopping; 0 means till the end.
+    int movesUntil = 0;
+    // Program to use as the UCI engine.
+    string engineName = "stockfish";
+    // Number of engines the games are shared between.
+    unsigned engines = 1;
+    // Share the plies of each game between the engines, rather than
+    // whole games, so a single game is analysed sooner.
+    bool splitPlies = false;
+    // Take the played move's value, when the engine did not choose it,
+    // from the search of the position after it rather than searching it
+    // again with searchmoves, as long as that position is analysed too.
+    bool reuseNextPly = false;
+    // UCI options set on the engine.
+    map<string, string> engineOptions;
+    // Which colours we wish to analyse.
+    bool analyseWhite = true;
+    bool analyseBlack = true;
+    // Whether to output the games with annotations.
+    bool annotate = false;
+    // Whether the output is XML.
+    bool XMLformat = true;
+    // Path, without the .stats.txt suffix, of the statistics file.
+    // No statistics are recorded if it is empty.
+    string statsFile;
+    // Where the statistics are written instead of statsFile, if set.
+    ostream *statsStream = nullptr;
+    // File of the persistent evaluation cache; no cache if it is empty.
+    // The games must carry the hash code of each position as a comment
+    // after its move (pgn-extract --hashcomments) for it to be used.
+    string cacheFile;
+    // Seconds allowed for the search of a position before the engine is
+    // told to stop, and then restarted if it does not; 0 for no limit.
+    int searchTimeout = 0;
+};
+
+class Engine;
+class EngineHost;
+class EvalCache;
+class Evaluation;
+
+/*
+ * One analysis run: its settings, its engines, the evaluation cache,
+ * the numbering of the games analysed and where the output goes.
+ * Nothing is shared between sessions, so several may run at once
+ * on separate threads of one process.
+ */
+class AnalysisSession {
+public:
+
+    AnalysisSession(const AnalysisOptions& options, ostream& out);
+    virtual ~AnalysisSession();
+
+    bool analyseFiles(const vector<string>& files);
+    bool analyseStream(istream& movestream);
+
+private:
+
+    struct Analyser;
+    struct PlyJob;
+    struct GameJob;
+    struct AnalysisTask;
+    struct GameQueue;
+    struct HostedTask;
+
+    void openCache(void);
+    void closeCache(void);
+    bool startAnalysers(void);
+    void stopAnalysers(void);
+    bool processMovesFile(const string& movesFile);
+    void processGames(istream& movestream);
+    void analyseQueuedGames(Analyser *analyser, GameQueue *queue);
+    void searchForTask(unsigned index, HostedTask& current, bool playedMoveOnly);
+    void continueTask(unsigned index, HostedTask& current, GameQueue *queue);
+    void driveEngines(GameQueue *queue);
+    void wakeEngineHost(void);
+    void writeGame(GameJob& game);
+    void writeCompletedGames(GameQueue *queue);
+    bool readGame(istream& movestream, GameJob& game);
+    void prepareGame(GameJob& game);
+    void analysePly(Analyser& analyser, GameJob& game, PlyJob& ply);
+    bool startPly(GameJob& game, PlyJob& ply);
+    bool followMateLine(GameJob& game, PlyJob& ply);
+    void keepMateLine(GameJob& game, const PlyJob& ply);
+    bool needsPlayedMoveSearch(PlyJob& ply);
+    void finishPly(GameJob& game, PlyJob& ply, bool searched);
+    void searchPlayedMove(Engine *engine, PlyJob& ply);
+    void valueDeferredMoves(Analyser& analyser, GameJob& game);
+    bool valueFromNextPly(GameJob& game, PlyJob& ply);
+    void writeAnalysis(GameJob& game);
+    bool showEvaluationsForMove(const vector<Evaluation *>& evaluations,
+            const string& playedMove, bool white, ostream& out);
+    void outputTag(const string& tagLine, ostream& out);
+    void obtainEvaluations(Engine *engine, vector<Evaluation *>& evaluations,
+            string *mateLine);
+
+    // Settings taken from the AnalysisOptions of the session.
+    int defaultBookDepth;
+    unsigned numVariations;
+    int searchDepth;
+    int defaultMovesUntil; // 0 means till the end
+    // The analysis engine.
+    string engineName;
+    map<string, string> engineOptions;
+    // Which colours we wish to analyse.
+    bool analyseWhite;
+    bool analyseBlack;
+    // Whether to output the game with annotations.
+    bool annotate;
+    // Whether the output is XML.
+    bool XMLformat;
+    // The number of engines sharing the games.
+    unsigned numEngines;
+    // Whether the engines share the plies of each game, rather than whole games.
+    bool splitPlies;
+    // Whether played moves are valued from the search of the next ply.
+    bool reuseNextPly;
+    // Path, without the .stats.txt suffix, of the statistics file.
+    string statsFile;
+    // Where the statistics are written, instead of statsFile.
+    ostream *statsStream;
+    // The name of the evaluation cache, if one is used.
+    string cacheFile;
+    // Seconds allowed for a search before the engine is stopped; 0 for no limit.
+    int searchTimeout;
+
+    // Where the analysis is written.
+    ostream *output;
+    // The engines of the session.
+    vector<Analyser> analysers;
+    // The identity of the engines.
+    string engineIdentity;
+    // The number of games analysed so far, which numbers their statistics.
+    size_t analysedGames;
+    // Evaluations of positions met before.
+    EvalCache *cache;
+    // Runs the engines and drives them from a single thread, on Linux.
+    EngineHost *engineHost;
+};
+
+/*
+ * Analyse the games in files, or on stdin if there are none,
+ * writing the analysis to stdout.
+ */
+bool runEngine(const vector<string>& files, const AnalysisOptions& options);
+/*
+ * Analyse the games read from movestream, writing the analysis to out.
+ */
+bool analyseStream(istream& movestream, ostream& out, const AnalysisOptions& options);
+
+#endif
@@ -0,0 +1,430 @@
+#ifdef __linux__
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "enginehost.h"
+
+using namespace std;
+
+// In analyse.cpp.
+void extractInfo(vector<Evaluation *>& evaluations, string_view info, int searchDepth,
+        string *mateLine);
+void keepMatingMoves(const vector<Evaluation *>& evaluations, const Evaluation *ev,
+        string_view pv, string *mateLine);
+void saveEvaluation(vector<Evaluation *>& evaluations, Evaluation *ev);
+
+// The epoll data of the wake-up event, in place of an engine's index.
+#define WAKE_EVENT UINT32_MAX
+// The most events taken from one wait.
+#define MAX_EVENTS 32
+// Milliseconds an engine is given to answer stop before it is killed.
+#define STOP_GRACE 2000
+// The most times an engine is replaced without completing a search
+// in between, so that one that always fails is given up.
+#define MAX_FAILURES 2
+
+EngineHost::EngineHost(const string& name, int numVariations, int depth,
+        const map<string, string>& engineOptions, int timeoutSeconds)
+    : engineName(name), variations(numVariations), searchDepth(depth),
+      options(engineOptions), timeout(timeoutSeconds * 1000L),
+      restarts(0), timeouts(0) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        throw -1;
+    }
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = WAKE_EVENT;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) != 0) {
+        throw -1;
+    }
+    // Writing to an engine that has died must fail, rather than
+    // take the whole process with it, so that it can be replaced.
+    signal(SIGPIPE, SIG_IGN);
+}
+
+EngineHost::~EngineHost() {
+    for (unsigned i = 0; i < engines.size(); i++) {
+        if (engines[i].engine != NULL) {
+            engines[i].engine->quitEngine();
+            delete engines[i].engine;
+        }
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+/*
+ * Start numEngines engines and wait for them to be initialised.
+ * Return false if one of them could not be.
+ */
+bool EngineHost::start(unsigned numEngines) {
+    for (unsigned i = 0; i < numEngines; i++) {
+        HostedEngine hosted;
+        hosted.engine = NULL;
+        hosted.state = FAILED;
+        hosted.started = false;
+        hosted.searchWaiting = false;
+        hosted.evaluations = NULL;
+        hosted.mateLine = NULL;
+        hosted.complete = false;
+        hosted.failures = 0;
+        hosted.hasDeadline = false;
+        hosted.stopSent = false;
+        engines.push_back(hosted);
+        if (!launch(i)) {
+            return false;
+        }
+    }
+    return waitForEngines();
+}
+
+/*
+ * The identity of the engines.
+ */
+string EngineHost::getIdentity(void) {
+    return engines.empty() || engines[0].engine == NULL ?
+            "unknown" : engines[0].engine->getIdentity();
+}
+
+/*
+ * Start a new engine at index and its initialisation.
+ * Return false if it could not be started.
+ */
+bool EngineHost::launch(unsigned index) {
+    HostedEngine& hosted = engines[index];
+    try {
+        hosted.engine = new Engine(engineName);
+    } catch (int e) {
+        hosted.engine = NULL;
+        hosted.state = FAILED;
+        return false;
+    }
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = index;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, hosted.engine->getReplyDescriptor(), &event) != 0) {
+        hosted.state = FAILED;
+        return false;
+    }
+    hosted.state = STARTING;
+    hosted.started = false;
+    hosted.engine->startInit(variations, searchDepth);
+    setDeadline(hosted);
+    return true;
+}
+
+/*
+ * Wait until every engine has been initialised.
+ * Return false if one of them failed.
+ */
+bool EngineHost::waitForEngines(void) {
+    deque<Result> results;
+    bool woken;
+    while (true) {
+        bool starting = false;
+        for (unsigned i = 0; i < engines.size(); i++) {
+            if (engines[i].state == FAILED) {
+                return false;
+            }
+            if (engines[i].state == STARTING || engines[i].state == SYNCING) {
+                starting = true;
+            }
+        }
+        if (!starting) {
+            return true;
+        }
+        if (!poll(results, woken)) {
+            return false;
+        }
+    }
+}
+
+/*
+ * Start a search by the idle engine at index of the position after moves,
+ * of every move or only of searchMoves if it is not empty, collecting its
+ * evaluations in evaluations, and the moves of a best line that is a forced
+ * mate in mateLine if it is not NULL. If newGame is set the engine is
+ * reset first.
+ */
+void EngineHost::search(unsigned index, bool newGame, const string& moves,
+        const string& fenstring, const string& searchMoves,
+        vector<Evaluation *> *evaluations, string *mateLine) {
+    HostedEngine& hosted = engines[index];
+    if (hosted.state == FAILED) {
+        failed.push_back(Result{index, false});
+        return;
+    }
+    hosted.moves = moves;
+    hosted.fenstring = fenstring;
+    hosted.searchMoves = searchMoves;
+    hosted.evaluations = evaluations;
+    hosted.mateLine = mateLine;
+    if (newGame) {
+        hosted.engine->send("ucinewgame");
+        hosted.engine->send("isready");
+        hosted.state = SYNCING;
+        hosted.searchWaiting = true;
+        setDeadline(hosted);
+    } else {
+        startSearch(hosted);
+    }
+}
+
+void EngineHost::startSearch(HostedEngine& hosted) {
+    hosted.engine->setPosition(hosted.moves, hosted.fenstring);
+    if (hosted.searchMoves.empty()) {
+        hosted.engine->go();
+    } else {
+        hosted.engine->searchMoves(hosted.searchMoves);
+    }
+    hosted.state = SEARCHING;
+    hosted.searchWaiting = false;
+    hosted.partial.clear();
+    hosted.complete = false;
+    setDeadline(hosted);
+}
+
+/*
+ * Give the engine the time allowed to answer what it was just sent.
+ */
+void EngineHost::setDeadline(HostedEngine& hosted) {
+    hosted.hasDeadline = timeout > 0;
+    hosted.deadline = Clock::now() + chrono::milliseconds(timeout);
+    hosted.stopSent = false;
+}
+
+/*
+ * Wait until at least one search is complete, adding the results
+ * to results, or until wake() is called.
+ * Return false if the wait failed.
+ */
+bool EngineHost::waitForResults(deque<Result>& results) {
+    size_t before = results.size();
+    bool woken = false;
+    while (results.size() == before && !woken) {
+        if (!failed.empty()) {
+            results.insert(results.end(), failed.begin(), failed.end());
+            failed.clear();
+        } else if (!poll(results, woken)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Interrupt waitForResults, from any thread.
+ */
+void EngineHost::wake(void) {
+    uint64_t one = 1;
+    // This only fails if the counter would overflow, so a wake-up is pending anyway.
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void) written;
+}
+
+/*
+ * Wait for replies from the engines and handle them, until the next
+ * deadline at the latest.
+ * Set woken if wake() was called.
+ * Return false if the wait failed.
+ */
+bool EngineHost::poll(deque<Result>& results, bool& woken) {
+    epoll_event events[MAX_EVENTS];
+    int numEvents = epoll_wait(epollFd, events, MAX_EVENTS, timeUntilDeadline());
+    if (numEvents < 0) {
+        return errno == EINTR;
+    }
+    for (int i = 0; i < numEvents; i++) {
+        if (events[i].data.u32 == WAKE_EVENT) {
+            uint64_t count;
+            ssize_t bytesRead = read(wakeFd, &count, sizeof(count));
+            (void) bytesRead;
+            woken = true;
+        } else {
+            readReplies(events[i].data.u32, results);
+        }
+    }
+    checkDeadlines(results);
+    return true;
+}
+
+/*
+ * The milliseconds until the earliest deadline of an engine,
+ * or -1 if there is none.
+ */
+int EngineHost::timeUntilDeadline(void) {
+    bool found = false;
+    Clock::time_point earliest;
+    for (unsigned i = 0; i < engines.size(); i++) {
+        const HostedEngine& hosted = engines[i];
+        if (hosted.hasDeadline && (!found || hosted.deadline < earliest)) {
+            earliest = hosted.deadline;
+            found = true;
+        }
+    }
+    if (!found) {
+        return -1;
+    }
+    auto wait = chrono::duration_cast<chrono::milliseconds>(earliest - Clock::now()).count();
+    // Round up, so as not to wake just before the deadline.
+    return wait < 0 ? 0 : (int) wait + 1;
+}
+
+/*
+ * Deal with the engines that have not answered in time: a search is
+ * told to stop, and an engine that still does not answer is replaced.
+ */
+void EngineHost::checkDeadlines(deque<Result>& results) {
+    Clock::time_point now = Clock::now();
+    for (unsigned i = 0; i < engines.size(); i++) {
+        HostedEngine& hosted = engines[i];
+        if (!hosted.hasDeadline || hosted.deadline > now) {
+            continue;
+        }
+        if (!hosted.stopSent) {
+            timeouts++;
+        }
+        if (hosted.state == SEARCHING && !hosted.stopSent) {
+            // Its bestmove completes the search, with whatever
+            // lines reached the full depth.
+            hosted.engine->send("stop");
+            hosted.stopSent = true;
+            hosted.deadline = now + chrono::milliseconds(STOP_GRACE);
+        } else {
+            restart(i, results);
+        }
+    }
+}
+
+/*
+ * Read what the engine at index has sent and handle its complete lines.
+ */
+void EngineHost::readReplies(unsigned index, deque<Result>& results) {
+    HostedEngine& hosted = engines[index];
+    if (!hosted.engine->readMore()) {
+        restart(index, results);
+        return;
+    }
+    string_view line;
+    while (hosted.state != FAILED && hosted.engine->takeLine(line)) {
+        handleReply(index, line, results);
+    }
+}
+
+/*
+ * Move the engine at index on according to a line it sent.
+ */
+void EngineHost::handleReply(unsigned index, string_view line, deque<Result>& results) {
+    HostedEngine& hosted = engines[index];
+    switch (hosted.state) {
+        case STARTING:
+            if (!hosted.engine->noteIdentity(line) && line == "uciok") {
+                hosted.engine->configure(options);
+                hosted.state = SYNCING;
+            }
+            break;
+        case SYNCING:
+            if (line == "readyok") {
+                hosted.started = true;
+                if (hosted.searchWaiting) {
+                    startSearch(hosted);
+                } else {
+                    hosted.state = IDLE;
+                    hosted.hasDeadline = false;
+                }
+            }
+            break;
+        case SEARCHING:
+            if (line.compare(0, 5, "info ") == 0) {
+                if (timeout > 0) {
+                    keepInfo(hosted, line);
+                } else {
+                    extractInfo(*hosted.evaluations, line, searchDepth, hosted.mateLine);
+                }
+            } else if (line.compare(0, 8, "bestmove") == 0) {
+                if (hosted.stopSent && !hosted.complete) {
+                    // Cut short: make do with the shallower lines.
+                    for (unsigned i = 0; i < hosted.partial.size(); i++) {
+                        saveEvaluation(*hosted.evaluations, new Evaluation(hosted.partial[i]));
+                    }
+                }
+                hosted.state = IDLE;
+                hosted.hasDeadline = false;
+                hosted.failures = 0;
+                results.push_back(Result{index, true});
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Collect the evaluation in an info line of a search that has a deadline,
+ * keeping it aside if it is not at the full depth.
+ */
+void EngineHost::keepInfo(HostedEngine& hosted, string_view line) {
+    Evaluation ev;
+    string_view pv;
+    if (!ev.parseInfo(line, 0, &pv)) {
+        return;
+    }
+    if (ev.getDepth() == searchDepth) {
+        hosted.complete = true;
+        Evaluation *saved = new Evaluation(ev);
+        saveEvaluation(*hosted.evaluations, saved);
+        keepMatingMoves(*hosted.evaluations, saved, pv, hosted.mateLine);
+        return;
+    }
+    for (unsigned i = 0; i < hosted.partial.size(); i++) {
+        if (hosted.partial[i].getVariation() == ev.getVariation()) {
+            hosted.partial[i] = ev;
+            return;
+        }
+    }
+    hosted.partial.push_back(ev);
+}
+
+/*
+ * Replace the engine at index, which has closed its pipe or stopped
+ * answering, with a new one, and start its search again on that.
+ * An engine that fails before it has been initialised, or that keeps
+ * failing, is not replaced, and the search fails.
+ */
+void EngineHost::restart(unsigned index, deque<Result>& results) {
+    HostedEngine& hosted = engines[index];
+    bool interrupted = hosted.state == SEARCHING || hosted.searchWaiting;
+    bool replace = hosted.started && hosted.failures < MAX_FAILURES;
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, hosted.engine->getReplyDescriptor(), NULL);
+    hosted.engine->killEngine();
+    delete hosted.engine;
+    hosted.engine = NULL;
+    hosted.state = FAILED;
+    hosted.hasDeadline = false;
+
+    if (replace) {
+        restarts++;
+        hosted.failures++;
+        if (!launch(index)) {
+            cerr << "Failed to restart " << engineName << endl;
+        }
+    }
+    if (interrupted) {
+        if (hosted.state != FAILED) {
+            hosted.searchWaiting = true;
+        } else {
+            hosted.searchWaiting = false;
+            results.push_back(Result{index, false});
+        }
+    }
+}
+
+#endif
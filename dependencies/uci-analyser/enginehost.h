@@ -0,0 +1,138 @@
+#ifndef ENGINEHOST_H
+#define ENGINEHOST_H
+
+#ifdef __linux__
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine.h"
+#include "evaluation.h"
+
+using namespace std;
+
+/*
+ * Runs a number of engines and drives them from a single thread,
+ * waiting with epoll on the pipes of all of them at once rather than
+ * with a thread blocked on each.
+ *
+ * Each engine goes from starting (waiting for uciok) through syncing
+ * (waiting for readyok) to idle; a search takes it to searching until
+ * its bestmove. The evaluations of a search are collected as its info
+ * lines arrive, and its result is queued when it is complete.
+ *
+ * The host keeps an eye on the health of its engines. A search that
+ * overruns the deadline is told to stop, and if the engine does not
+ * answer that either it is killed. An engine that has died, or been
+ * killed, is replaced by a new one with the same options, and the
+ * search it was making is started again on it.
+ */
+class EngineHost {
+public:
+
+    /*
+     * A completed search.
+     */
+    struct Result {
+        // The index of the engine that made it.
+        unsigned engine;
+        // False if the engine failed before the search was complete.
+        bool ok;
+    };
+
+    EngineHost(const string& engineName, int variations, int searchDepth,
+            const map<string, string>& options, int timeout);
+    virtual ~EngineHost();
+
+    bool start(unsigned numEngines);
+    string getIdentity(void);
+    void search(unsigned engine, bool newGame, const string& moves,
+            const string& fenstring, const string& searchMoves,
+            vector<Evaluation *> *evaluations, string *mateLine);
+    bool waitForResults(deque<Result>& results);
+    void wake(void);
+
+    inline unsigned long getRestarts(void) const {
+        return restarts;
+    }
+
+    inline unsigned long getTimeouts(void) const {
+        return timeouts;
+    }
+
+private:
+
+    typedef chrono::steady_clock Clock;
+
+    enum State {
+        STARTING, SYNCING, IDLE, SEARCHING, FAILED
+    };
+
+    /*
+     * An engine and where it is in its dialogue.
+     */
+    struct HostedEngine {
+        Engine *engine;
+        State state;
+        // Whether the engine has been initialised since it was started.
+        bool started;
+        // The search to start once the engine is synchronised.
+        bool searchWaiting;
+        string moves;
+        string fenstring;
+        string searchMoves;
+        // Where the evaluations of the search are collected.
+        vector<Evaluation *> *evaluations;
+        // Where the moves of a best line that is a forced mate are kept.
+        string *mateLine;
+        // With a deadline, the latest line of each variation, whatever
+        // its depth, to fall back on if the search is stopped before
+        // any line reaches the full depth.
+        vector<Evaluation> partial;
+        bool complete;
+        // The times the engine has been replaced since it last
+        // completed a search.
+        unsigned failures;
+        // When the engine is next checked on, if it has a deadline,
+        // and whether it has been told to stop.
+        bool hasDeadline;
+        Clock::time_point deadline;
+        bool stopSent;
+    };
+
+    bool launch(unsigned index);
+    bool waitForEngines(void);
+    bool poll(deque<Result>& results, bool& woken);
+    int timeUntilDeadline(void);
+    void checkDeadlines(deque<Result>& results);
+    void setDeadline(HostedEngine& hosted);
+    void readReplies(unsigned index, deque<Result>& results);
+    void handleReply(unsigned index, string_view line, deque<Result>& results);
+    void keepInfo(HostedEngine& hosted, string_view line);
+    void startSearch(HostedEngine& hosted);
+    void restart(unsigned index, deque<Result>& results);
+
+    string engineName;
+    int variations;
+    int searchDepth;
+    // The options set once an engine is identified.
+    map<string, string> options;
+    // Milliseconds allowed for a search; no deadline if zero.
+    long timeout;
+    int epollFd;
+    // Written to by wake().
+    int wakeFd;
+    vector<HostedEngine> engines;
+    // Searches that failed as they were started.
+    deque<Result> failed;
+    unsigned long restarts;
+    unsigned long timeouts;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,290 @@
+#include <cstddef>
+#include <iostream>
+#include <string.h>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "evalcache.h"
+
+using namespace std;
+
+// Identifies the file format.
+static const char CACHE_MAGIC[8] = { 'U', 'C', 'I', 'E', 'V', 'A', 'L', '1' };
+static const uint32_t CACHE_VERSION = 1;
+// The number of slots in a new file, a power of two.
+static const uint32_t CACHE_SLOTS = 1 << 18;
+// A position may be stored in any slot of its bucket.
+static const uint32_t BUCKET_SIZE = 4;
+
+// Flags of a cached line.
+static const uint8_t LINE_MATE = 0x1;
+static const uint8_t LINE_LOWER_BOUND = 0x2;
+static const uint8_t LINE_UPPER_BOUND = 0x4;
+
+// The longest UCI move, e.g. e7e8q.
+#define MAX_MOVE_LEN 5
+
+struct EvalCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t numSlots;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/*
+ * The first move and score of one line of an evaluation.
+ */
+struct CachedLine {
+    char move[MAX_MOVE_LEN + 1];
+    uint8_t variation;
+    uint8_t flags;
+    // Centipawns, or the moves to mate.
+    int32_t value;
+};
+
+struct EvalCache::Slot {
+    uint64_t position;
+    uint64_t engine;
+    // Hash of the rest of the slot, to detect a torn write.
+    uint64_t check;
+    int16_t depth;
+    uint8_t variations;
+    // Zero for an empty slot.
+    uint8_t numLines;
+    uint32_t unused;
+    CachedLine lines[EvalCache::MAX_LINES];
+};
+
+/*
+ * 64-bit FNV-1a hash of len bytes of data, continuing from hash.
+ */
+static uint64_t fnv1a(const void *data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/*
+ * The check value of a slot: a hash of everything but the check itself.
+ */
+static uint64_t slotCheck(const void *slot, size_t checkOffset, size_t size) {
+    uint64_t hash = fnv1a(slot, checkOffset);
+    size_t rest = checkOffset + sizeof(uint64_t);
+    return fnv1a((const char *) slot + rest, size - rest, hash);
+}
+
+EvalCache::EvalCache() : header(NULL), slots(NULL), mappedSize(0), hits(0), misses(0) {
+}
+
+/*
+ * Map the cache in filename, creating it if it does not exist.
+ * Return whether the cache is ready for use.
+ */
+bool EvalCache::open(const string& filename) {
+    close();
+#ifdef __unix__
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        cerr << "Unable to open the evaluation cache " << filename << endl;
+        return false;
+    }
+    // Keep other processes out while the file is set up.
+    flock(fd, LOCK_EX);
+
+    bool ok = true;
+    struct stat details;
+    size_t size = sizeof(Header) + (size_t) CACHE_SLOTS * sizeof(Slot);
+    if (fstat(fd, &details) != 0) {
+        ok = false;
+    } else if (details.st_size == 0) {
+        ok = ftruncate(fd, size) == 0;
+    } else {
+        size = details.st_size;
+    }
+
+    void *mapping = MAP_FAILED;
+    if (ok && size >= sizeof(Header)) {
+        mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapping != MAP_FAILED) {
+        Header *mapped = (Header *) mapping;
+        if (details.st_size == 0) {
+            memcpy(mapped->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+            mapped->version = CACHE_VERSION;
+            mapped->numSlots = CACHE_SLOTS;
+            mapped->hits = mapped->misses = 0;
+        }
+        uint32_t numSlots = mapped->numSlots;
+        if (memcmp(mapped->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                mapped->version == CACHE_VERSION &&
+                numSlots >= BUCKET_SIZE && (numSlots & (numSlots - 1)) == 0 &&
+                size == sizeof(Header) + (size_t) numSlots * sizeof(Slot)) {
+            header = mapped;
+            slots = (Slot *) (mapped + 1);
+            mappedSize = size;
+        } else {
+            munmap(mapping, size);
+            cerr << filename << " is not an evaluation cache of this version." << endl;
+        }
+    } else {
+        cerr << "Unable to map the evaluation cache " << filename << endl;
+    }
+
+    flock(fd, LOCK_UN);
+    ::close(fd);
+    return isOpen();
+#else
+    cerr << "The evaluation cache is not supported on this platform." << endl;
+    return false;
+#endif
+}
+
+/*
+ * Unmap the cache, if it is open.
+ */
+void EvalCache::close(void) {
+#ifdef __unix__
+    if (header != NULL) {
+        munmap(header, mappedSize);
+    }
+#endif
+    header = NULL;
+    slots = NULL;
+    mappedSize = 0;
+}
+
+unsigned long long EvalCache::getTotalHits(void) const {
+    return header != NULL ? __atomic_load_n(&header->hits, __ATOMIC_RELAXED) : 0;
+}
+
+unsigned long long EvalCache::getTotalMisses(void) const {
+    return header != NULL ? __atomic_load_n(&header->misses, __ATOMIC_RELAXED) : 0;
+}
+
+/*
+ * Return the slot holding the position, or else the slot of its
+ * bucket to be replaced by it: an empty one or the shallowest.
+ */
+EvalCache::Slot *EvalCache::findSlot(uint64_t position, uint64_t engine, unsigned variations) {
+    uint32_t mask = header->numSlots - 1;
+    uint32_t first = (uint32_t) ((position ^ (engine * 0x9e3779b97f4a7c15ULL)) & mask) & ~(BUCKET_SIZE - 1);
+    Slot *replace = NULL;
+    for (uint32_t i = first; i < first + BUCKET_SIZE; i++) {
+        Slot *slot = &slots[i];
+        if (slot->numLines > 0 && slot->position == position &&
+                slot->engine == engine && slot->variations == variations) {
+            return slot;
+        }
+        if (replace == NULL) {
+            replace = slot;
+        } else if (replace->numLines > 0 &&
+                (slot->numLines == 0 || slot->depth < replace->depth)) {
+            replace = slot;
+        }
+    }
+    return replace;
+}
+
+/*
+ * Fill evaluations with the cached lines of the position, if it was
+ * analysed by engine with the same number of variations to at least
+ * searchDepth.
+ * Return whether it was found.
+ */
+bool EvalCache::lookup(uint64_t position, const string& engine, int searchDepth,
+        unsigned variations, vector<Evaluation *>& evaluations) {
+    uint64_t engineKey = fnv1a(engine.data(), engine.size());
+    Slot copy;
+    bool found = false;
+    {
+        lock_guard<mutex> guard(lock);
+        Slot *slot = findSlot(position, engineKey, variations);
+        if (slot->numLines > 0 && slot->position == position &&
+                slot->engine == engineKey && slot->variations == variations) {
+            copy = *slot;
+            found = true;
+        }
+    }
+    found = found && copy.depth >= searchDepth && copy.numLines <= MAX_LINES &&
+            copy.check == slotCheck(&copy, offsetof(Slot, check), sizeof(Slot));
+
+    if (found) {
+        for (unsigned i = 0; i < copy.numLines; i++) {
+            const CachedLine& line = copy.lines[i];
+            bool mate = (line.flags & LINE_MATE) != 0;
+            evaluations.push_back(new Evaluation(line.variation, copy.depth,
+                    mate ? 0 : line.value, mate, mate ? line.value : 0,
+                    (line.flags & LINE_LOWER_BOUND) != 0,
+                    (line.flags & LINE_UPPER_BOUND) != 0,
+                    string(line.move, strnlen(line.move, MAX_MOVE_LEN))));
+        }
+        hits++;
+        __atomic_fetch_add(&header->hits, 1, __ATOMIC_RELAXED);
+    } else {
+        misses++;
+        __atomic_fetch_add(&header->misses, 1, __ATOMIC_RELAXED);
+    }
+    return found;
+}
+
+/*
+ * Record the evaluations of the position made by engine at searchDepth,
+ * unless they will not fit, a deeper analysis is already held, or the
+ * search was cut short so that some lines are shallower.
+ */
+void EvalCache::store(uint64_t position, const string& engine, int searchDepth,
+        unsigned variations, const vector<Evaluation *>& evaluations) {
+    if (evaluations.empty() || evaluations.size() > MAX_LINES) {
+        return;
+    }
+    Slot entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.position = position;
+    entry.engine = fnv1a(engine.data(), engine.size());
+    entry.depth = searchDepth;
+    entry.variations = variations;
+    entry.numLines = evaluations.size();
+    for (unsigned i = 0; i < evaluations.size(); i++) {
+        const Evaluation *ev = evaluations[i];
+        string move = ev->getFirstMove();
+        if (move.length() > MAX_MOVE_LEN) {
+            return;
+        }
+        if (ev->getDepth() < searchDepth) {
+            return;
+        }
+        CachedLine& line = entry.lines[i];
+        memcpy(line.move, move.data(), move.length());
+        line.variation = ev->getVariation();
+        if (ev->isForcedMate()) {
+            line.flags |= LINE_MATE;
+            line.value = ev->getNumMateMoves();
+        } else {
+            line.value = ev->getValue();
+        }
+        if (ev->isLowerBound()) {
+            line.flags |= LINE_LOWER_BOUND;
+        } else if (ev->isUpperBound()) {
+            line.flags |= LINE_UPPER_BOUND;
+        }
+    }
+    entry.check = slotCheck(&entry, offsetof(Slot, check), sizeof(Slot));
+
+    lock_guard<mutex> guard(lock);
+    Slot *slot = findSlot(position, entry.engine, variations);
+    bool samePosition = slot->numLines > 0 && slot->position == position &&
+            slot->engine == entry.engine && slot->variations == variations;
+    if (!samePosition || slot->depth <= searchDepth) {
+        *slot = entry;
+    }
+}
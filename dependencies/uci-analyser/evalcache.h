@@ -0,0 +1,80 @@
+#ifndef EVALCACHE_H
+#define EVALCACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "evaluation.h"
+
+using namespace std;
+
+/*
+ * A persistent cache of the engine's evaluations of positions,
+ * kept in a memory-mapped file so that positions met in earlier
+ * games, or earlier runs, need not be searched again.
+ *
+ * Entries are keyed by the position's Zobrist hash code together
+ * with the engine's identity and the number of variations searched,
+ * and are served for any search depth up to the one they were made at.
+ * The file may be shared by several processes; an entry that was
+ * being rewritten while it was read fails its check and counts as a miss.
+ */
+class EvalCache {
+public:
+
+    EvalCache();
+
+    virtual ~EvalCache() {
+        close();
+    }
+
+    bool open(const string& filename);
+    void close(void);
+
+    inline bool isOpen(void) const {
+        return header != NULL;
+    }
+
+    bool lookup(uint64_t position, const string& engine, int searchDepth,
+            unsigned variations, vector<Evaluation *>& evaluations);
+    void store(uint64_t position, const string& engine, int searchDepth,
+            unsigned variations, const vector<Evaluation *>& evaluations);
+
+    // The hits and misses of this run.
+    inline unsigned long getHits(void) const {
+        return hits;
+    }
+
+    inline unsigned long getMisses(void) const {
+        return misses;
+    }
+
+    // The hits and misses of every run that used the file.
+    unsigned long long getTotalHits(void) const;
+    unsigned long long getTotalMisses(void) const;
+
+    // The most lines stored for a position: the variations
+    // plus the played move if it was searched separately.
+    static const unsigned MAX_LINES = 8;
+
+private:
+
+    struct Header;
+    struct Slot;
+
+    Slot *findSlot(uint64_t position, uint64_t engine, unsigned variations);
+
+    // The mapped file.
+    Header *header;
+    Slot *slots;
+    size_t mappedSize;
+    // Guards the slots against the other engines of this process.
+    mutex lock;
+    atomic<unsigned long> hits;
+    atomic<unsigned long> misses;
+};
+
+#endif
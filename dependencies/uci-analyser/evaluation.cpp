@@ -19,82 +19,110 @@
  *  https://www.cs.kent.ac.uk/people/staff/djb/
  */
 
-#include <iostream>
-#include <sstream>
+#include <charconv>
+#include <string.h>
 
 #include "evaluation.h"
-#include "utils.h"
 
 using namespace std;
 
+// What separates the tokens of an engine's line.
+static const char *SEPARATORS = " \t\r";
+
+/*
+ * Remove the next token from the front of text and return it.
+ * Return an empty token at the end of the text.
+ */
+static string_view nextToken(string_view& text) {
+    size_t start = text.find_first_not_of(SEPARATORS);
+    if (start == string_view::npos) {
+        text = string_view();
+        return text;
+    }
+    size_t end = text.find_first_of(SEPARATORS, start);
+    if (end == string_view::npos) {
+        end = text.size();
+    }
+    string_view token = text.substr(start, end - start);
+    text.remove_prefix(end);
+    return token;
+}
+
+/*
+ * The integer value of token, or 0 if it is not a number.
+ */
+static int tokenToInt(string_view token) {
+    int value = 0;
+    from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
 /*
  * Extract the evaluation details from an "info"
  * output from the engine.
+ * The engine sends many lines during a search; those for the moves
+ * being searched and for the lesser depths are rejected before the
+ * line is broken into tokens. With a searchDepth of 0 every depth
+ * is accepted.
  */
-void Evaluation::extractInfo(const vector<string> &tokens, const string& info) {
-    int numTokens = tokens.size();
-    this->cpValue = 0;
-    this->lowerBound = false;
-    this->upperBound = false;
-    this->variation = 0;
-    this->forcedMate = false;
-    this->mateInMoves = 0;
+bool Evaluation::parseInfo(string_view info, int searchDepth, string_view *pv) {
+    if (info.find(" multipv ") == string_view::npos ||
+            info.find(" currmove ") != string_view::npos) {
+        return false;
+    }
+    size_t depthIndex = info.find(" depth ");
+    if (depthIndex == string_view::npos) {
+        return false;
+    }
+    string_view depthValue = info.substr(depthIndex + strlen(" depth "));
+    if (searchDepth > 0 && tokenToInt(nextToken(depthValue)) != searchDepth) {
+        return false;
+    }
 
-    for (int t = 1; t < numTokens;) {
-        string token = tokens[t];
-        t++;
+    string_view rest = info;
+    if (nextToken(rest) != "info") {
+        return false;
+    }
+    *this = Evaluation();
+    // Values that are not needed, such as those of nodes and time,
+    // are passed over as unrecognised tokens.
+    for (string_view token = nextToken(rest); !token.empty(); token = nextToken(rest)) {
         if (token == "depth") {
-            string value = tokens[t];
-            t++;
-            this->depth = strToInt(value);
-        } else if (token == "seldepth") {
-            string depth = tokens[t];
-            t++;
+            depth = tokenToInt(nextToken(rest));
+        } else if (token == "multipv") {
+            variation = tokenToInt(nextToken(rest));
         } else if (token == "score") {
-            string scoreType = tokens[t];
-            t++;
+            string_view scoreType = nextToken(rest);
             if (scoreType == "cp") {
-                string value = tokens[t];
-                t++;
-                cpValue = strToInt(value);
+                cpValue = tokenToInt(nextToken(rest));
             } else if (scoreType == "mate") {
-                string moves = tokens[t];
-                t++;
-
                 forcedMate = true;
-                mateInMoves = strToInt(moves);
-            }
-            string nextToken = tokens[t];
-            if (nextToken == "lowerbound") {
-                lowerBound = true;
-                t++;
-            } else if (nextToken == "upperbound") {
-                upperBound = true;
-                t++;
+                mateInMoves = tokenToInt(nextToken(rest));
             }
-        } else if (token == "multipv") {
-            string multipv = tokens[t];
-            t++;
-            this->variation = strToInt(multipv);
-        } else if (token == "nodes") {
-            this->nodes = strToInt(tokens[t]);
-            t++;
-        } else if (token == "nps") {
-            string nps = tokens[t];
-            t++;
+        } else if (token == "lowerbound") {
+            lowerBound = true;
+        } else if (token == "upperbound") {
+            upperBound = true;
         } else if (token == "pv") {
-            // Remaining tokens are the moves of the line.
-            for (; t < numTokens; t++) {
-                this->moves.push_back(tokens[t]);
+            // Only the first move of the line is kept.
+            if (pv != NULL) {
+                *pv = rest;
             }
-        } else if (token == "time") {
-            this->time = tokens[t];
-            t++;
-        } else {
-#ifdef DEBUG
-            cout << "# Unrecognised token " << token << " in: " << endl;
-            cout << "# " << info << endl;
-#endif
+            setFirstMove(nextToken(rest));
+            break;
+        } else if (token == "string") {
+            // The rest of the line is free text.
+            break;
         }
     }
+    return true;
+}
+
+/*
+ * Keep move as the first move of the line.
+ */
+void Evaluation::setFirstMove(string_view move) {
+    size_t length = move.size() < EVALUATION_MOVELEN ? move.size() : EVALUATION_MOVELEN;
+    memcpy(firstMove, move.data(), length);
+    firstMove[length] = '\0';
 }
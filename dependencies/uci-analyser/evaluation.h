@@ -23,25 +23,47 @@
 #define EVALUATION_H
 
 #include <string>
-#include <vector>
+#include <string_view>
 
 using namespace std;
 
+// The longest first move of a line that is kept, e.g. e7e8q.
+#define EVALUATION_MOVELEN 5
+
 /*
- * Details of the evaluation of a line.
+ * Details of the evaluation of a line: its score and first move.
+ * It is a plain value, so an evaluation can be copied and kept
+ * (by the evaluation cache, for instance) without allocation.
  */
 class Evaluation
 {
   public:
-    Evaluation(const vector<string> &tokens, const string &info)
+    Evaluation()
+        : variation(0), depth(0), cpValue(0), mateInMoves(0),
+          lowerBound(false), upperBound(false), forcedMate(false)
     {
-        extractInfo(tokens, info);
+        firstMove[0] = '\0';
     }
 
-    virtual ~Evaluation()
+    /* An evaluation of the line starting with move, as recorded
+     * by the evaluation cache.
+     */
+    Evaluation(unsigned variationNumber, int lineDepth, int value, bool mate,
+            int mateMoves, bool lower, bool upper, const string &move)
+        : variation(variationNumber), depth(lineDepth), cpValue(value),
+          mateInMoves(mateMoves), lowerBound(lower), upperBound(upper),
+          forcedMate(mate)
     {
+        setFirstMove(move);
     }
 
+    /* Fill in the evaluation from an "info" line of the engine,
+     * setting pv, if it is given, to the moves of the line.
+     * Return false, leaving it incomplete, if the line is not the
+     * final line of a variation at searchDepth (at any depth if it is 0).
+     */
+    bool parseInfo(string_view info, int searchDepth, string_view *pv = NULL);
+
     inline unsigned getVariation() const
     {
         return variation;
@@ -81,12 +103,7 @@ class Evaluation
 
     inline string getFirstMove() const
     {
-        return moves[0];
-    }
-
-    inline string getTime() const
-    {
-        return time;
+        return firstMove;
     }
 
   private:
@@ -96,22 +113,18 @@ class Evaluation
       int depth;
       // The value in centi-pawns.
       int cpValue;
+      // Number of moves to mate (if forcedMate)
+      int mateInMoves;
       // This value is a lower bound.
       bool lowerBound;
       // This value is an upper bound.
       bool upperBound;
-      // The number of nodes.
-      int nodes;
-      // The time
-      string time;
       // Whether the move gives forced mate.
       bool forcedMate;
-      // Number of moves to mate (if forcedMate)
-      int mateInMoves;
-      // The moves of the line being evaluated.
-      vector<string> moves;
+      // The first move of the line being evaluated.
+      char firstMove[EVALUATION_MOVELEN + 1];
 
-      void extractInfo(const vector<string> &tokens, const string &info);
+      void setFirstMove(string_view move);
 };
 
 #endif
@@ -1,45 +1,38 @@
 #include <map>
 #include <cmath>
+#include <sstream>
 #include "interpret.hpp"
 
 using namespace std;
 
 namespace interpret
 {
-    short brilliantMoves[2];
-    short excellentMove[2];
-    short goodMove[2];
-    short inaccurateMove[2];
-    short mistake[2];
-    short blunder[2];
-    short missedWin[2];
-    long long playedEval[2];
-    long long bestEval[2];
-
-    ostringstream cpPrec;
-    
-    void initializeOStream()
+    // a value to two decimal places
+    static string fixedPrecision(long double value)
     {
+        ostringstream cpPrec;
         cpPrec << fixed;
         cpPrec << setprecision(2);
+        cpPrec << value;
+        return cpPrec.str();
     }
 
-    void clearStats()
+    void clearStats(Stats& stats)
     {
-        brilliantMoves[0] = brilliantMoves[1] = 0;
-        excellentMove[0] = excellentMove[1] = 0;
-        goodMove[0] = goodMove[1] = 0;
-        inaccurateMove[0] = inaccurateMove[1] = 0;
-        mistake[0] = mistake[1] = 0;
-        blunder[0] = blunder[1] = 0;
-        missedWin[0] = missedWin[1] = 0;
-        playedEval[0] = playedEval[1] = 0;
-        bestEval[0] = bestEval[1] = 0;
+        stats.brilliantMoves[0] = stats.brilliantMoves[1] = 0;
+        stats.excellentMove[0] = stats.excellentMove[1] = 0;
+        stats.goodMove[0] = stats.goodMove[1] = 0;
+        stats.inaccurateMove[0] = stats.inaccurateMove[1] = 0;
+        stats.mistake[0] = stats.mistake[1] = 0;
+        stats.blunder[0] = stats.blunder[1] = 0;
+        stats.missedWin[0] = stats.missedWin[1] = 0;
+        stats.playedEval[0] = stats.playedEval[1] = 0;
+        stats.bestEval[0] = stats.bestEval[1] = 0;
     }
 
-    void recordStats(const string& saveFile, bool color, size_t gameNumber)
+    void recordStats(ostream& out, bool color, size_t gameNumber, const Stats& stats)
     {
-        long long upper = playedEval[color], lower = bestEval[color];
+        long long upper = stats.playedEval[color], lower = stats.bestEval[color];
         
         if(upper<0 && lower<0)
         {
@@ -61,35 +54,35 @@ namespace interpret
                           "Game# : " + to_string(gameNumber) + "\n"
                           "COLOR : " + ColorLabel + "\n";
         statCounts.append(" - - - - - - - - Analyzed Move Counts - - - - - - - - \n");
-        statCounts.append( "\tBriliant Moves   - " + to_string(brilliantMoves[color]) + "\n");
-        statCounts.append( "\tExcellent Moves  - " + to_string(excellentMove[color]) + "\n");
-        statCounts.append( "\tGood Moves       - " + to_string(goodMove[color]) + "\n");
-        statCounts.append( "\tinaccurate Moves - " + to_string(inaccurateMove[color]) + "\n");
-        statCounts.append( "\tMistakes         - " + to_string(mistake[color]) + "\n");
-        statCounts.append( "\tBlunders         - " + to_string(blunder[color]) + "\n");
-        statCounts.append( "\tMissed Wins      - " + to_string(missedWin[color]) + "\n");
+        statCounts.append( "\tBriliant Moves   - " + to_string(stats.brilliantMoves[color]) + "\n");
+        statCounts.append( "\tExcellent Moves  - " + to_string(stats.excellentMove[color]) + "\n");
+        statCounts.append( "\tGood Moves       - " + to_string(stats.goodMove[color]) + "\n");
+        statCounts.append( "\tinaccurate Moves - " + to_string(stats.inaccurateMove[color]) + "\n");
+        statCounts.append( "\tMistakes         - " + to_string(stats.mistake[color]) + "\n");
+        statCounts.append( "\tBlunders         - " + to_string(stats.blunder[color]) + "\n");
+        statCounts.append( "\tMissed Wins      - " + to_string(stats.missedWin[color]) + "\n");
         statCounts.append( "\tTOTAL : " + to_string(
-          ( brilliantMoves[color] + excellentMove[color] + goodMove[color] + inaccurateMove[color] +
-            mistake[color] + blunder[color] + missedWin[color]))+"\n"
+          ( stats.brilliantMoves[color] + stats.excellentMove[color] + stats.goodMove[color] + stats.inaccurateMove[color] +
+            stats.mistake[color] + stats.blunder[color] + stats.missedWin[color]))+"\n"
           );
 
         #ifndef PRODUCTION
-        statCounts.append("\nPlayed Move Total Centipawns = " + to_string(playedEval[color]));
-        statCounts.append("\nBest Move Total Centipawns = " + to_string(bestEval[color]));
+        statCounts.append("\nPlayed Move Total Centipawns = " + to_string(stats.playedEval[color]));
+        statCounts.append("\nBest Move Total Centipawns = " + to_string(stats.bestEval[color]));
         statCounts.append("\nmin|max = "+to_string(upper)+"|" + to_string(lower));
         #endif
         
-        cpPrec.str("");
-        cpPrec.clear();
-        cpPrec << accuracy;
-        statCounts.append("\n\tAccuracy : "+cpPrec.str()+"%\n\n");
-        cpPrec.str("");
-        cpPrec.clear();
+        statCounts.append("\n\tAccuracy : "+fixedPrecision(accuracy)+"%\n\n");
+
+        out<<"==============================================================\n";
+        out<<statCounts;
+    }
 
+    void recordStats(const string& saveFile, bool color, size_t gameNumber, const Stats& stats)
+    {
         ofstream outfile;
         outfile.open(saveFile+".stats.txt",ios_base::out | ios_base::app);
-        outfile<<"==============================================================\n";
-        outfile<<statCounts;
+        recordStats(outfile,color,gameNumber,stats);
         outfile.close();
     }
 
@@ -103,66 +96,62 @@ namespace interpret
         else          strForm.append("(");
 
         centipawns/=100;
-        cpPrec << centipawns;
 
-        strForm.append(cpPrec.str()+")");
-        
-        cpPrec.str("");
-        cpPrec.clear();
+        strForm.append(fixedPrecision(centipawns)+")");
 
         return strForm;
     }
 
-    void playedMove(int played_move, int best_move, bool color)
+    void playedMove(int played_move, int best_move, bool color, Stats& stats, ostream& out)
     {
         int interpretation = played_move-best_move;
 
-        playedEval[color] += played_move;
-        bestEval[color] += best_move;
+        stats.playedEval[color] += played_move;
+        stats.bestEval[color] += best_move;
     
         if(played_move==best_move)
         {
-            brilliantMoves[color]++;
-            cout<<" brilliant!!! ";
+            stats.brilliantMoves[color]++;
+            out<<" brilliant!!! ";
         }
         else if(interpretation >  -10)
         {
-            excellentMove[color]++;
-            cout<<" excellent!! ";
+            stats.excellentMove[color]++;
+            out<<" excellent!! ";
         }
         else if(interpretation >  -50)
         {
-            goodMove[color]++;
-            cout<<" good! ";
+            stats.goodMove[color]++;
+            out<<" good! ";
         }
         else if(interpretation > -100)
         {
-            inaccurateMove[color]++;
-            cout<<" inaccurate? ";
+            stats.inaccurateMove[color]++;
+            out<<" inaccurate? ";
         }
         else if(interpretation > -200)
         {
-            mistake[color]++;
-            cout<<" mistake?? ";
+            stats.mistake[color]++;
+            out<<" mistake?? ";
         }
         else
         {
             if(played_move<0)
             {
-                blunder[color]++;
-                cout<<" blunder??? ";
+                stats.blunder[color]++;
+                out<<" blunder??? ";
             }
             else
             {
-                missedWin[color]++;
-                cout<<" missed??? ";
+                stats.missedWin[color]++;
+                out<<" missed??? ";
             }
         }
 
-        if      (played_move>400) cout << " - W ";
-        else if(played_move<-400) cout << " - L ";
+        if      (played_move>400) out << " - W ";
+        else if(played_move<-400) out << " - L ";
 
-        cout << displayCP(played_move) ;
+        out << displayCP(played_move) ;
     }
 
     std::string get_execpath()
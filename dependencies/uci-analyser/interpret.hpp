@@ -17,11 +17,25 @@
 
 namespace interpret
 {
-    void initializeOStream();
-    void clearStats();
-    void recordStats(const std::string& saveFile, bool color, size_t gameNumber);
+    // counts of the played moves of a game, indexed by color
+    struct Stats
+    {
+        short brilliantMoves[2];
+        short excellentMove[2];
+        short goodMove[2];
+        short inaccurateMove[2];
+        short mistake[2];
+        short blunder[2];
+        short missedWin[2];
+        long long playedEval[2];
+        long long bestEval[2];
+    };
+
+    void clearStats(Stats& stats);
+    void recordStats(std::ostream& out, bool color, size_t gameNumber, const Stats& stats);
+    void recordStats(const std::string& saveFile, bool color, size_t gameNumber, const Stats& stats);
     std::string displayCP(int cpEval);
-    void playedMove(int played_move, int best_move, bool color);
+    void playedMove(int played_move, int best_move, bool color, Stats& stats, std::ostream& out);
     std::string get_execpath();
 }
 
@@ -0,0 +1,245 @@
+/*
+ *  This file is part of uci-analyser: a UCI-based Chess Game Analyser
+ *  Copyright (C) 2013-2017 David J. Barnes
+ *
+ *  uci-analyser is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  uci-analyser is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with uci-analyser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#include "string.h"
+#include "utils.h"
+#include "analyse.h"
+
+using namespace std;
+
+/* Command-line front end of the analyser.
+ * The analysis itself is in analyse.cpp, so that it can also
+ * be linked into other programs as libucianalyser.a.
+ */
+
+static const char *VERSION = "2017.04.07";
+
+void showUsage(const char *programName);
+
+#ifdef __unix__
+
+int main(int argc, char *argv[]) {
+#else
+
+int main(int argc, char *argv[]) {
+#endif
+
+    AnalysisOptions options;
+    bool ok = true;
+    int argnum = 1;
+
+
+    // Process --arguments.
+    for (; argnum < argc && strncmp(argv[argnum], "--", 2) == 0;) {
+        string arg(argv[argnum]);
+        argnum++;
+
+        if (arg == "--annotate") {
+            options.annotate = true;
+        } else if (arg == "--annotatePGN") {
+            options.annotate = true;
+            options.XMLformat = false;
+        } else if (arg == "--blackonly") {
+            if (options.analyseBlack) {
+                options.analyseWhite = false;
+                options.analyseBlack = true;
+            } else {
+                cerr << arg << " << conflicts with --whiteonly" << endl;
+                ok = false;
+            }
+        } else if (arg == "--bookdepth") {
+            if (argnum < argc) {
+                string depth(argv[argnum]);
+                argnum++;
+                options.bookDepth = strToInt(depth);
+            } else {
+                cerr << "Missing value argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--searchdepth") {
+            if (argnum < argc) {
+                string depth(argv[argnum]);
+                argnum++;
+                options.searchDepth = strToInt(depth);
+            } else {
+                cerr << "Missing value argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--engine") {
+            if (argnum < argc) {
+                options.engineName = argv[argnum];
+                argnum++;
+            } else {
+                cerr << "Missing engine name argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--engines") {
+            if (argnum < argc) {
+                string engines(argv[argnum]);
+                argnum++;
+                int n = strToInt(engines);
+                if (n > 0) {
+                    options.engines = n;
+                } else {
+                    cerr << "Invalid number of engines: " << engines << endl;
+                    ok = false;
+                }
+            } else {
+                cerr << "Missing value argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--splitplies") {
+            options.splitPlies = true;
+        } else if (arg == "--nextply") {
+            options.reuseNextPly = true;
+        } else if (arg == "--cache") {
+            if (argnum < argc) {
+                options.cacheFile = argv[argnum];
+                argnum++;
+            } else {
+                cerr << "Missing file argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--timeout") {
+            if (argnum < argc) {
+                string timeout(argv[argnum]);
+                argnum++;
+                int n = strToInt(timeout);
+                if (n >= 0) {
+                    options.searchTimeout = n;
+                } else {
+                    cerr << "Invalid timeout: " << timeout << endl;
+                    ok = false;
+                }
+            } else {
+                cerr << "Missing value argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--help") {
+            showUsage(argv[0]);
+        } else if (arg == "--setoption") {
+            if (argnum + 1 < argc) {
+                string name(argv[argnum]);
+                string value(argv[argnum + 1]);
+                argnum += 2;
+
+                options.engineOptions[name] = value;
+            } else {
+                cerr << "Missing name and/or value argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--variations") {
+            if (argnum < argc) {
+                string vars(argv[argnum]);
+                argnum++;
+                options.variations = strToInt(vars);
+            } else {
+                cerr << "Missing value argument to " << arg << endl;
+                ok = false;
+            }
+        } else if (arg == "--version") {
+            cout << "Version: " << VERSION << endl;
+        } else if (arg == "--whiteonly") {
+            if (options.analyseWhite) {
+                options.analyseWhite = true;
+                options.analyseBlack = false;
+            } else {
+                cerr << arg << " << conflicts with --blackonly" << endl;
+                ok = false;
+            }
+        } else if (arg == "--movesuntil") {
+            if (argnum < argc) {
+                string movesUntil(argv[argnum]);
+                argnum++;
+                options.movesUntil = strToInt(movesUntil);
+            } else {
+                cerr << "Missing value argument to " << arg << endl;
+                ok = false;
+            }
+        } else {
+            cerr << "Unknown argument: " << arg << endl;
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        vector<string> files;
+        for (; argnum < argc; argnum++) {
+            files.push_back(argv[argnum]);
+        }
+        // Statistics are recorded alongside the last file.
+        if (files.size() > 0) {
+            options.statsFile = files.back();
+        }
+        ok = runEngine(files, options);
+        return ok ? 0 : -1;
+    } else {
+        showUsage(argv[0]);
+        return -2;
+    }
+}
+
+void showUsage(const char *programName) {
+    cerr << "Usage: " << programName << "\n" <<
+            "    [--annotate]\n" <<
+            "        output the games with evaluation annotations\n" <<
+            "    [--annotatePGN]\n" <<
+            "        output the game with evaluation annotations in PGN format\n" <<
+            "    [--blackonly]\n" <<
+            "        only analyse black's moves\n" <<
+            "    [--bookdepth depth]\n" <<
+            "        depth in ply to skip at start of game\n" <<
+            "    [--searchdepth depth]\n" <<
+            "        search depth in ply\n" <<
+            "    [--engine program]\n" <<
+            "        program to use as the UCI engine\n" <<
+            "    [--engines n]\n" <<
+            "        number of engines to share the games between\n" <<
+            "    [--splitplies]\n" <<
+            "        share the plies of each game, not whole games, between the engines\n" <<
+            "    [--nextply]\n" <<
+            "        value a played move the engine did not choose from the search of the next ply\n" <<
+            "    [--cache file]\n" <<
+            "        reuse evaluations kept in file (moves from pgn-extract --hashcomments)\n" <<
+            "    [--timeout seconds]\n" <<
+            "        stop a search that takes longer, restarting an engine that hangs or dies\n" <<
+            "    [--help]\n" <<
+            "        show this usage message\n" <<
+            "    [--setoption optionName optionValue]\n " <<
+            "        set a UCI option\n" <<
+            "    [--variations vars]\n" <<
+            "        number of variations to analyse per move\n" <<
+            "    [--version]\n" <<
+            "        show the current version\n" <<
+            "    [--whiteonly]\n" <<
+            "        only analyse white's moves\n" <<
+            "    [--movesuntil in ply]\n" <<
+            "        number of moves to analyse before stopping\n" <<
+            "    file [...]\n" <<
+            "        file(s) to be analysed." <<
+            endl;
+    exit(-2);
+}
@@ -1,11 +1,18 @@
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <iostream>
 #include <vector>
 #include <cstring>
 #include <fstream>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#endif
+
 #include "convert.hpp"
 #include "apgnFileSys.hpp"
+#include "apgnJobs.hpp"
 
 #define DEBUG_PRINT(MSG) std::cerr << MSG << "\n"
 
@@ -40,12 +47,29 @@ if(INDEX+1>=ARG_COUNT) \
 #define ANALYSE_COLOR "-color"
 #define ANALYSE_OPENNING_SKIP "-oskip"
 #define ANALYSE_UNTIL "-movesuntil"
+#define ANALYSE_JOBS "-jobs"
+#define ANALYSE_ENGINES "-engines"
+#define ANALYSE_SPLIT "-split"
+#define ANALYSE_STATS_FD "-statsfd"
+#define ANALYSE_STDIN "-"
+#define ANALYSE_CACHE "-cache"
+#define ANALYSE_PLAYED "-played"
+#define ANALYSE_VARIATIONS "-variations"
+#define ANALYSE_TIMEOUT "-timeout"
+#define ANALYSE_BOOK "-book"
 
 #define DEFAULT_THREAD 1
 #define DEFAULT_DEPTH 18
 #define DEFAULT_COLOR 'A'
 #define DEAFULT_OPENNING_MOVE_SKIP 0
 #define DEFAULT_MOVES_UNTIL 0 // 0 means analyse all moves
+#define DEFAULT_JOBS 1
+#define DEFAULT_ENGINES 1
+#define DEFAULT_SPLIT "games"
+#define DEFAULT_STATS_FD 3
+#define DEFAULT_PLAYED "search"
+#define DEFAULT_VARIATIONS 5
+#define DEFAULT_TIMEOUT 0 // 0 means no time limit
 
 static std::string PGN_EXT = ".pgn";
 
@@ -58,6 +82,11 @@ std::string DEFAULT_ENGINE()
     #endif
 }
 
+std::string DEFAULT_ECO_FILE()
+{
+    return (std::filesystem::path(apgnFileSys::getExecpath()) / "dependencies" / "pgn-extract" / "eco.pgn").string();
+}
+
 bool isNumber(const std::string& input)
 {
     std::string::const_iterator i = input.begin();
@@ -129,9 +158,11 @@ int main(int argc, char* argv[])
                 "\t                  filename of your pgn file\n\n"
                 "\t" << ANALYSE_COLOR << " [A,W,B]  - select one letter from A, W or B, where\n"
                 "\t                  W = white, B = black, and A = both\n\n"
-                "\t" << ANALYSE_OPENNING_SKIP << " [N>=0]  - this is the number of moves in the opening\n"
+                "\t" << ANALYSE_OPENNING_SKIP << " [N>=0,eco] - this is the number of moves in the opening\n"
                 "\t                  that the engine will not analyse\n"
-                "\t                  this value should be >= 0 and < the total moves\n\n"
+                "\t                  this value should be >= 0 and < the total moves,\n"
+                "\t                  with eco each game is analysed from where it leaves\n"
+                "\t                  the opening lines of " << DEFAULT_ECO_FILE() << "\n\n"
                 "\t" << ANALYSE_UNTIL << " [N>=1 and N > -oskip N]  - this is the number of moves to analyse\n"
                 "\t                  by default if a number is not specified, the program will\n"
                 "\t                  analyse all the moves in a pgn game\n\n"
@@ -144,6 +175,38 @@ int main(int argc, char* argv[])
                 "\t                  the analysis, given that you did not exceed your CPUs\n"
                 "\t                  maximum thread, but if you did a bigger thread will\n"
                 "\t                  also slow down the analysis\n\n"
+                "\t" << ANALYSE_JOBS << " [N>0]    - this is the number of pgn files to analyse at the\n"
+                "\t                  same time, each with its own engine, if " << ANALYSE_THREADS << " is\n"
+                "\t                  not given the CPU cores are split evenly between the\n"
+                "\t                  engines, the results are the same as for one job\n\n"
+                "\t" << ANALYSE_ENGINES << " [N>0] - this is the number of engines that share the games\n"
+                "\t                  of a pgn file, the analysed games are written in\n"
+                "\t                  their original order, the CPU cores are split between\n"
+                "\t                  every engine of every job like for " << ANALYSE_JOBS << "\n\n"
+                "\t" << ANALYSE_SPLIT << " [games,plies] - what the engines of " << ANALYSE_ENGINES << " share, whole\n"
+                "\t                  games, or the plies of each game so a single game\n"
+                "\t                  is analysed sooner\n\n"
+                "\t" << ANALYSE_STDIN << "              - read the pgn games from stdin and write them\n"
+                "\t                  analysed to stdout game by game, instead of the\n"
+                "\t                  pgn files, the stats go to " << ANALYSE_STATS_FD << "\n\n"
+                "\t" << ANALYSE_STATS_FD << " [N>=0] - the file descriptor the stats are written to\n"
+                "\t                  with " << ANALYSE_STDIN << ", they are not recorded if it is not open\n\n"
+                "\t" << ANALYSE_CACHE << " [FILE]  - keep the engine's evaluations of every position in\n"
+                "\t                  this file, positions found in it from earlier games or\n"
+                "\t                  runs are not searched again, it is created if missing\n\n"
+                "\t" << ANALYSE_PLAYED << " [search,nextply] - how a played move the engine did not\n"
+                "\t                  choose is valued, by searching it again, or from the\n"
+                "\t                  search of the next move when both colors are analysed\n\n"
+                "\t" << ANALYSE_VARIATIONS << " [N>0] - this is the number of best lines (MultiPV) the\n"
+                "\t                  engine searches for each move, 1 is the fastest, the\n"
+                "\t                  played move is then searched on its own whenever it\n"
+                "\t                  is not the best move, and is classified the same way\n\n"
+                "\t" << ANALYSE_TIMEOUT << " [N>=0] - the seconds an engine is given to search a move,\n"
+                "\t                  one that takes longer is stopped, and one that hangs\n"
+                "\t                  or crashes is restarted, 0 means no time limit\n\n"
+                "\t" << ANALYSE_BOOK << " [FILE]   - a polyglot (.bin) opening book, the moves played\n"
+                "\t                  from a position that are among its moves for that\n"
+                "\t                  position are not analysed\n\n"
 
                 "\tif a flags is not specified, the default value of that flag will be used,\n"
                 "\tbelow are the default value of each flags\n\n"
@@ -153,6 +216,13 @@ int main(int argc, char* argv[])
                 "\t    movesuntil - " << DEFAULT_MOVES_UNTIL << "\n"
                 "\t    depth      - " << DEFAULT_DEPTH << "\n"
                 "\t    threads    - " << DEFAULT_THREAD << "\n"
+                "\t    jobs       - " << DEFAULT_JOBS << "\n"
+                "\t    engines    - " << DEFAULT_ENGINES << "\n"
+                "\t    split      - " << DEFAULT_SPLIT << "\n"
+                "\t    statsfd    - " << DEFAULT_STATS_FD << "\n"
+                "\t    played     - " << DEFAULT_PLAYED << "\n"
+                "\t    variations - " << DEFAULT_VARIATIONS << "\n"
+                "\t    timeout    - " << DEFAULT_TIMEOUT << "\n"
 
                 "\n\n\tExample Using Default Values:\n\n"
                 "\t\tapgn myGame1.pgn myGame2.pgn\n\n\n"
@@ -160,6 +230,7 @@ int main(int argc, char* argv[])
                 "\tExample Using Costum Values:\n\n"
                 "\t    apgn -color B -threads 4 myGame1.pgn myGame2.pgn\n\n\t    another one\n\n"
                 "\t    apgn -engine C:/User/Downloads/Stockfish8.exe -depth 25 myGame1.pgn\n\n"
+                "\t    apgn - < myGames.pgn > myGames.analyzed.pgn 3> myGames.stats.txt\n\n"
                 "\t    NOTE: this examples will use the costum values for the specified flags\n"
                 "\t          and use the default values for the unspecified flags.\n";
 
@@ -175,9 +246,14 @@ int main(int argc, char* argv[])
 
     std::string engine = DEFAULT_ENGINE();
     int thread = DEFAULT_THREAD;
+    bool thread_given = false;
+    int jobs = DEFAULT_JOBS;
+    int engines = DEFAULT_ENGINES;
+    std::string split = DEFAULT_SPLIT;
     int depth  = DEFAULT_DEPTH;
     char color = DEFAULT_COLOR;
     int openning_move_skip = DEAFULT_OPENNING_MOVE_SKIP;
+    bool eco_skip = false;
     int movesUntil = DEFAULT_MOVES_UNTIL;
 
     std::vector<std::string> ARGUMENTS;
@@ -186,6 +262,16 @@ int main(int argc, char* argv[])
 
     for(int i=1; i<argc; ++i) ARGUMENTS.push_back(argv[i]);
 
+    // with "-" stdout carries the analysed games, so everything else goes to stderr
+    bool stream_mode = std::find(ARGUMENTS.begin(), ARGUMENTS.end(), ANALYSE_STDIN) != ARGUMENTS.end();
+    std::ostream& info = stream_mode ? std::cerr : std::cout;
+    int stats_fd = DEFAULT_STATS_FD;
+    std::string cache;
+    std::string played = DEFAULT_PLAYED;
+    int variations = DEFAULT_VARIATIONS;
+    int timeout = DEFAULT_TIMEOUT;
+    std::string book;
+
     for(size_t i=0; i<ARGUMENTS.size(); ++i)
     {
         if(ARGUMENTS[i]==ANALYSE_ENGINE)
@@ -205,6 +291,7 @@ int main(int argc, char* argv[])
             if(isNumber(ARGUMENTS[++i]))
             {
                 thread = std::atoi(ARGUMENTS[i].data());
+                thread_given = true;
             }
             else ASSERT_INVALID("thread value", ARGUMENTS[i-1], ARGUMENTS[i]);
         }
@@ -235,6 +322,13 @@ int main(int argc, char* argv[])
             if(isNumber(ARGUMENTS[++i]))
             {
                 openning_move_skip = std::atoi(ARGUMENTS[i].data());
+                eco_skip = false;
+            }
+            else if(ARGUMENTS[i]=="eco")
+            {
+                // games without a BookDepth tag of their own get one from the ECO lines
+                openning_move_skip = 0;
+                eco_skip = true;
             }
             else ASSERT_INVALID("openning skip counts", ARGUMENTS[i-1], ARGUMENTS[i]);
         }
@@ -248,6 +342,96 @@ int main(int argc, char* argv[])
             }
             else ASSERT_INVALID("moves to analyse", ARGUMENTS[i-1], ARGUMENTS[i]);
         }
+        else if(ARGUMENTS[i]==ANALYSE_JOBS)
+        {
+            // DEBUG_PRINT("JOBS FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(isNumber(ARGUMENTS[++i]) && std::atoi(ARGUMENTS[i].data())>0)
+            {
+                jobs = std::atoi(ARGUMENTS[i].data());
+            }
+            else ASSERT_INVALID("number of jobs", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_ENGINES)
+        {
+            // DEBUG_PRINT("ENGINES FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(isNumber(ARGUMENTS[++i]) && std::atoi(ARGUMENTS[i].data())>0)
+            {
+                engines = std::atoi(ARGUMENTS[i].data());
+            }
+            else ASSERT_INVALID("number of engines", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_SPLIT)
+        {
+            // DEBUG_PRINT("SPLIT FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(ARGUMENTS[++i]=="games" || ARGUMENTS[i]=="plies")
+            {
+                split = ARGUMENTS[i];
+            }
+            else ASSERT_INVALID("split", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_STATS_FD)
+        {
+            // DEBUG_PRINT("STATS FD FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(isNumber(ARGUMENTS[++i]))
+            {
+                stats_fd = std::atoi(ARGUMENTS[i].data());
+            }
+            else ASSERT_INVALID("stats file descriptor", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_CACHE)
+        {
+            // DEBUG_PRINT("CACHE FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            cache = ARGUMENTS[++i];
+        }
+        else if(ARGUMENTS[i]==ANALYSE_PLAYED)
+        {
+            // DEBUG_PRINT("PLAYED FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(ARGUMENTS[++i]=="search" || ARGUMENTS[i]=="nextply")
+            {
+                played = ARGUMENTS[i];
+            }
+            else ASSERT_INVALID("played", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_VARIATIONS)
+        {
+            // DEBUG_PRINT("VARIATIONS FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(isNumber(ARGUMENTS[++i]) && std::atoi(ARGUMENTS[i].data())>0)
+            {
+                variations = std::atoi(ARGUMENTS[i].data());
+            }
+            else ASSERT_INVALID("number of variations", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_TIMEOUT)
+        {
+            // DEBUG_PRINT("TIMEOUT FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(isNumber(ARGUMENTS[++i]))
+            {
+                timeout = std::atoi(ARGUMENTS[i].data());
+            }
+            else ASSERT_INVALID("search timeout", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_BOOK)
+        {
+            // DEBUG_PRINT("BOOK FLAG DETECTED");
+            ASSERT_MISSING_FLAGVALUE(i,ARGUMENTS.size(),ARGUMENTS[i]);
+            if(std::filesystem::exists(ARGUMENTS[++i]))
+            {
+                book = ARGUMENTS[i];
+            }
+            else ASSERT_INVALID("polyglot book", ARGUMENTS[i-1], ARGUMENTS[i]);
+        }
+        else if(ARGUMENTS[i]==ANALYSE_STDIN)
+        {
+            // DEBUG_PRINT("STDIN FLAG DETECTED");
+        }
         else if(isPGN(ARGUMENTS[i]))
         {
             // DEBUG_PRINT("A PGN FILE IS DETECTED");
@@ -261,57 +445,142 @@ int main(int argc, char* argv[])
         }
         else
         {
-            std::cout << "Ignoring the unknown parameter '" << ARGUMENTS[i] << "\n";
+            info << "Ignoring the unknown parameter '" << ARGUMENTS[i] << "\n";
         }
     }
 
+    // more jobs than files would only idle
+    if((size_t)jobs>PGN_GAMES.size() && !PGN_GAMES.empty()) jobs = PGN_GAMES.size();
+    if(jobs*engines>1 && !thread_given) thread = apgnJobs::engineThreads(jobs*engines);
+
     // display analysis information
-    std::cout <<
+    info <<
         "\nEngine  : " << engine << "\n"
         "Threads : " << thread << "\n"
+        "Jobs    : " << jobs << "\n"
+        "Engines : " << engines << "\n"
+        "Split   : " << split << "\n"
+        "Cache   : " << (cache.empty() ? "none" : cache) << "\n"
+        "Book    : " << (book.empty() ? "none" : book) << "\n"
+        "Played  : " << played << "\n"
+        "Variations : " << variations << "\n"
+        "Timeout : " << (timeout ? std::to_string(timeout)+"s" : "none") << "\n"
         "Depth   : " << depth << "\n"
         "Color   : " << color << "\n"
         "Moves   : " << movesUntil << "\n"
-        "Openning Moves to Skip : " << openning_move_skip << "\n\n";
+        "Openning Moves to Skip : " << (eco_skip ? "eco" : std::to_string(openning_move_skip)) << "\n\n";
 
     if(depth>12)
     {
-        std::cout <<
+        info <<
             "NOTE: depth is set greater than 12!!!\n"
             "      analysis might take longer...\n\n";
     }
     
+    if(eco_skip)
+    {
+        // read before any jobs start, so that they share the lines
+        try {
+            apgn_convert::use_eco_book_depth(DEFAULT_ECO_FILE());
+        }
+        catch(const std::exception& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+    }
+
+    if(!book.empty())
+    {
+        // opened before any jobs start, so that they share the mapping
+        try {
+            apgn_convert::use_polyglot_book(book);
+        }
+        catch(const std::exception& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+    }
+
+    if(stream_mode)
+    {
+        if(!PGN_GAMES.empty()) info << "Ignoring the pgn files, the games are read from stdin\n";
+
+        AnalysisOptions options = apgn_convert::analysis_options(
+            "",
+            engine,
+            depth,
+            thread,
+            engines,
+            split=="plies",
+            openning_move_skip,
+            movesUntil,
+            color
+        );
+        options.cacheFile = cache;
+        options.reuseNextPly = played=="nextply";
+        options.variations = variations;
+        options.searchTimeout = timeout;
+
+        #if !defined(_WIN32)
+        // the stats are written only if the caller opened the descriptor for them
+        apgn_convert::fd_streambuf stats_buffer(stats_fd);
+        std::ostream stats(&stats_buffer);
+        if(fcntl(stats_fd, F_GETFD) != -1) options.statsStream = &stats;
+        else info << "No file descriptor " << stats_fd << " for the stats, they are not recorded\n";
+        #else
+        info << "The stats are not recorded when reading from stdin on this platform\n";
+        #endif
+
+        try {
+            apgn_convert::analyse_stdin(options);
+        }
+        catch(const std::exception& err) {
+            std::cerr << err.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
     // start analysing games
-    for(size_t i=0; i<PGN_GAMES.size(); ++i)
+    auto start = std::chrono::steady_clock::now();
+    size_t failed = apgnJobs::runConcurrently(PGN_GAMES.size(), jobs, [&](size_t i)
     {
         std::cout << "Analysing " << PGN_GAMES[i] << " please wait...\n";
 
-        apgn_convert::pgn_to_uci(std::filesystem::path(PGN_GAMES[i]).string(),std::filesystem::path(FILENAME[i]).string());
-
         /* clear the stats file if it exists */ {
             std::ofstream existing_stat_file;
             existing_stat_file.open(FILENAME[i]+".stats.txt",std::ios_base::out | std::ios_base::trunc);
             existing_stat_file.close();
         }
 
-        apgn_convert::analyse_game(
+        AnalysisOptions options = apgn_convert::analysis_options(
             FILENAME[i],
-            FILENAME[i]+".analyzed",
             engine,
-            std::to_string(depth).data(),
-            std::to_string(thread).data(),
-            std::to_string(openning_move_skip).data(),
-            std::to_string(movesUntil).data(),
+            depth,
+            thread,
+            engines,
+            split=="plies",
+            openning_move_skip,
+            movesUntil,
             color
         );
-        apgn_convert::uci_to_pgn(FILENAME[i]+".analyzed",FILENAME[i]+".analyzed.pgn");
+        options.cacheFile = cache;
+        options.reuseNextPly = played=="nextply";
+        options.variations = variations;
+        options.searchTimeout = timeout;
 
-        // clean temporary files
-        apgnFileSys::deleteFile(FILENAME[i]);
-        apgnFileSys::deleteFile(FILENAME[i]+".analyzed");
+        std::string uci_games = apgn_convert::pgn_to_uci(PGN_GAMES[i], apgn_convert::uci_flags(options));
+        apgn_convert::analyse_to_pgn(uci_games,options,FILENAME[i]+".analyzed.pgn");
+    });
+
+    if(failed)
+    {
+        std::cerr << "Failed to analyse " << failed << " of the PGN files\n";
     }
 
-    std::cout << "Analyzed PGN files: " << PGN_GAMES.size() << "\n";
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()-start;
+    std::cout << "Analyzed PGN files: " << PGN_GAMES.size()-failed << "\n";
+    std::cout << "Time    : " << elapsed.count() << "s\n";
 
-    return 0;
+    return failed ? 1 : 0;
 }
\ No newline at end of file